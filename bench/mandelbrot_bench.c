@@ -0,0 +1,231 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <inttypes.h>
+#include <math.h>
+
+#include <bignum.h>
+#include <bla.h>
+#include <camera.h>
+#include <cpu_render.h>
+#include <kernels.h>
+#include <mandelbrot.h>
+#include <perturbation.h>
+#include <util.h>
+
+// fixed scenes rendered the same way on every run, timed per frame and
+// reported as JSON, so numbers from different commits can be compared.
+// every CPU backend that applies to a scene gets timed: each supported isa
+// for the ones float can still resolve, perturbation with and without BLA
+// for the ones past double
+
+typedef struct {
+    const char* name;
+    const char* re;
+    const char* im;
+    double zoom;
+    uint32_t width, height;
+    uint32_t max_iter;
+} scene_t;
+
+static const scene_t SCENES[] = {
+    { "full", "-0.5", "0", 1.25, 1024, 1024, 256 },
+    { "seahorse", "-0.743643887037151", "0.131825904205330", 2e-3, 1024, 1024, 2000 },
+    { "elephant", "0.2925", "0.0149", 5e-3, 1024, 1024, 1000 },
+    // a period 998 minibrot down the seahorse valley
+    {
+        "deep_minibrot",
+        "-0.743643887037158870778064543493642575047609962321255060213888",
+        "0.131825904205312292821097354874767265262988599679042974937477",
+        1e-15, 256, 256, 20000,
+    },
+};
+#define NUM_SCENES (sizeof(SCENES) / sizeof(SCENES[0]))
+
+typedef struct {
+    uint32_t runs;
+    uint32_t threads;
+    const char* scenes;     // comma separated names, NULL = all
+    const char* output;     // NULL = stdout
+} bench_options_t;
+
+// nearest rank of sorted times
+static double percentile(const double* sorted, uint32_t count, double p) {
+    uint32_t rank = (uint32_t) ceil(p / 100. * count);
+    return sorted[(rank > 0 ? rank : 1) - 1];
+}
+
+// what the frame iterated, counting interior pixels at max_iter
+static uint64_t count_iterations(const iter_buffer_t* iters) {
+    uint64_t total = 0;
+    for (size_t i = 0; i < (size_t) iters->width * iters->height; i++) {
+        total += (iters->iter[i] < iters->max_iter) ? iters->iter[i] : iters->max_iter;
+    }
+    return total;
+}
+
+static bool scene_selected(const bench_options_t* opts, const char* name) {
+    if (!opts->scenes) {
+        return true;
+    }
+    size_t len = strlen(name);
+    for (const char* s = opts->scenes; s; s = strchr(s, ',') ? strchr(s, ',') + 1 : NULL) {
+        if (strncmp(s, name, len) == 0 && (s[len] == ',' || s[len] == '\0')) {
+            return true;
+        }
+    }
+    return false;
+}
+
+typedef struct {
+    FILE* out;
+    bool first;
+} json_t;
+
+// one warm-up frame, then opts->runs timed ones
+static void bench_backend(json_t* json, const bench_options_t* opts, cpu_renderer_t* renderer, const scene_t* scene, const view_t* view, const char* backend, const perturb_frame_t* perturb, iter_buffer_t* iters) {
+    pixel_rect_t all = { 0, 0, view->width, view->height };
+    double* times = malloc(opts->runs * sizeof(double));
+    cpu_renderer_render_rect(renderer, view, perturb, &all, iters);
+    for (uint32_t r = 0; r < opts->runs; r++) {
+        double start = now_seconds();
+        cpu_renderer_render_rect(renderer, view, perturb, &all, iters);
+        times[r] = now_seconds() - start;
+    }
+    qsort(times, opts->runs, sizeof(double), compare_double);
+
+    double median = percentile(times, opts->runs, 50.);
+    double pixels = (double) view->width * view->height;
+    uint64_t iterations = count_iterations(iters);
+    fprintf(
+        json->out,
+        "%s\n    {\"scene\": \"%s\", \"backend\": \"%s\", \"width\": %" PRIu32 ", \"height\": %" PRIu32 ", \"max_iter\": %" PRIu32
+        ", \"runs\": %" PRIu32 ", \"median_ms\": %.4f, \"p95_ms\": %.4f, \"p99_ms\": %.4f, \"min_ms\": %.4f"
+        ", \"pixels_per_sec\": %.6g, \"iterations\": %" PRIu64 ", \"iterations_per_sec\": %.6g}",
+        json->first ? "" : ",", scene->name, backend, view->width, view->height, view_max_iter(view),
+        opts->runs, median * 1e3, percentile(times, opts->runs, 95.) * 1e3, percentile(times, opts->runs, 99.) * 1e3, times[0] * 1e3,
+        pixels / median, iterations, (double) iterations / median
+    );
+    json->first = false;
+    fprintf(stderr, "%-14s %-18s median %9.3f ms\n", scene->name, backend, median * 1e3);
+    free(times);
+}
+
+// false if the scene's center doesn't parse
+static bool bench_scene(json_t* json, const bench_options_t* opts, cpu_renderer_t* renderer, const scene_t* scene) {
+    camera_t camera;
+    camera_init(&camera, 0., 0., scene->zoom);
+    if (!camera_set_center_decimal(&camera, scene->re, scene->im)) {
+        fprintf(stderr, "%s: center isn't a decimal number\n", scene->name);
+        return false;
+    }
+    view_t view = camera_view(&camera, scene->width, scene->height, scene->max_iter);
+    iter_buffer_t* iters = iter_buffer_create(view.width, view.height);
+
+    if (kernel_double_precision_ok(&view)) {
+        // past float every isa would fall back to scalar, so only time that
+        bool float_ok = kernel_float_precision_ok(&view);
+        for (isa_t isa = ISA_SCALAR; isa < ISA_COUNT; isa++) {
+            if (!isa_supported(isa) || (isa != ISA_SCALAR && !float_ok)) {
+                continue;
+            }
+            cpu_renderer_set_isa(renderer, isa);
+            char backend[32];
+            snprintf(backend, sizeof(backend), "cpu-%s", isa_name(isa));
+            bench_backend(json, opts, renderer, scene, &view, backend, NULL, iters);
+        }
+        cpu_renderer_set_isa(renderer, ISA_AUTO);
+    } else {
+        uint32_t precision_bits = perturb_precision_bits(view_pixel_size(&view));
+        bignum_t* c_re = bignum_create(bignum_limbs_for_bits(precision_bits));
+        bignum_t* c_im = bignum_create(bignum_limbs_for_bits(precision_bits));
+        if (!bignum_set_decimal(c_re, scene->re) || !bignum_set_decimal(c_im, scene->im)) {
+            fprintf(stderr, "%s: center doesn't fit %" PRIu32 " bits\n", scene->name, precision_bits);
+            bignum_destroy(c_im);
+            bignum_destroy(c_re);
+            iter_buffer_destroy(iters);
+            return false;
+        }
+        reference_orbit_t* ref = reference_orbit_compute_parallel(c_re, c_im, precision_bits, view_max_iter(&view), NULL);
+        double dc_max = view_pixel_size(&view) * hypot(view.width, view.height);
+        bla_table_t* bla = bla_table_build(ref, dc_max, bla_epsilon(view_pixel_size(&view), dc_max, BLA_EPSILON_DOUBLE));
+
+        perturb_frame_t perturb = { .ref = ref };
+        bench_backend(json, opts, renderer, scene, &view, "cpu-perturbed", &perturb, iters);
+        perturb.bla = bla;
+        bench_backend(json, opts, renderer, scene, &view, "cpu-perturbed-bla", &perturb, iters);
+
+        bla_table_destroy(bla);
+        reference_orbit_destroy(ref);
+        bignum_destroy(c_im);
+        bignum_destroy(c_re);
+    }
+    iter_buffer_destroy(iters);
+    return true;
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr,
+        "usage: %s [options]\n"
+        "  --runs=N         timed frames per scene and backend, after one warm-up (default 10)\n"
+        "  --threads=N      worker threads, 0 = all cores (default 0)\n"
+        "  --scenes=A,B     only these of full, seahorse, elephant, deep_minibrot (default all)\n"
+        "  --output=FILE    write the JSON here instead of stdout\n",
+        prog
+    );
+}
+
+int main(int argc, char** argv) {
+    bench_options_t opts = {
+        .runs = 10,
+        .threads = 0,
+        .scenes = NULL,
+        .output = NULL,
+    };
+    for (int i = 1; i < argc; i++) {
+        const char* v;
+        bool ok = true;
+        if ((v = flag_value(argv[i], "--runs"))) {
+            ok = parse_u32(v, &opts.runs) && opts.runs > 0;
+        } else if ((v = flag_value(argv[i], "--threads"))) {
+            ok = parse_u32(v, &opts.threads);
+        } else if ((v = flag_value(argv[i], "--scenes"))) {
+            opts.scenes = v;
+        } else if ((v = flag_value(argv[i], "--output"))) {
+            opts.output = v;
+        } else if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0) {
+            usage(argv[0]);
+            return 0;
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            fprintf(stderr, "Bad argument: %s\n", argv[i]);
+            usage(argv[0]);
+            return -1;
+        }
+    }
+
+    json_t json = { .out = stdout, .first = true };
+    if (opts.output && !(json.out = fopen(opts.output, "w"))) {
+        fprintf(stderr, "Failed to create %s\n", opts.output);
+        return -1;
+    }
+
+    cpu_renderer_t* renderer = cpu_renderer_create(opts.threads, 0, ISA_AUTO);
+    fprintf(
+        json.out, "{\n  \"threads\": %" PRIu32 ",\n  \"best_isa\": \"%s\",\n  \"results\": [",
+        cpu_renderer_num_threads(renderer), isa_name(isa_best_supported())
+    );
+    bool ok = true;
+    for (uint32_t s = 0; s < NUM_SCENES; s++) {
+        if (scene_selected(&opts, SCENES[s].name)) {
+            ok = bench_scene(&json, &opts, renderer, &SCENES[s]) && ok;
+        }
+    }
+    fprintf(json.out, "\n  ]\n}\n");
+    cpu_renderer_destroy(renderer);
+
+    return (fclose(json.out) == 0 && ok) ? 0 : -1;
+}
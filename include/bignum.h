@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <inttypes.h>
+
+// sign-magnitude fixed-point numbers for the deep zoom reference orbit. the
+// magnitude is num_limbs 32-bit limbs, least significant first; the top limb
+// is the integer part and the rest are fraction. every operand of an
+// operation must have the same num_limbs unless noted
+
+#define BIGNUM_LIMB_BITS 32
+
+typedef struct {
+    uint32_t num_limbs;
+    bool negative;
+    uint32_t* limbs;
+} bignum_t;
+
+// enough whole fraction limbs to hold precision_bits, plus the integer limb
+uint32_t bignum_limbs_for_bits(uint32_t precision_bits);
+
+bignum_t* bignum_create(uint32_t num_limbs);
+void bignum_destroy(bignum_t* a);
+
+// the one operation that takes mixed precisions: truncates or zero-extends
+void bignum_copy(bignum_t* out, const bignum_t* a);
+void bignum_set_zero(bignum_t* out);
+// exact as long as v has no bits below the precision
+void bignum_set_double(bignum_t* out, double v);
+// [-+]digits[.digits][e[-+]digits], truncated to out's precision; false (and
+// out untouched) on anything else, or if the integer part doesn't fit a limb
+bool bignum_set_decimal(bignum_t* out, const char* s);
+
+double bignum_to_double(const bignum_t* a);
+// writes at most num_digits fraction digits; returns snprintf-style length
+int bignum_to_decimal(const bignum_t* a, uint32_t num_digits, char* out, size_t out_size);
+
+bool bignum_is_zero(const bignum_t* a);
+
+// out may alias a or b in all of these
+void bignum_add(bignum_t* out, const bignum_t* a, const bignum_t* b);
+void bignum_sub(bignum_t* out, const bignum_t* a, const bignum_t* b);
+void bignum_mul(bignum_t* out, const bignum_t* a, const bignum_t* b);
+// bignum_mul(out, a, a) with each cross product done once, about half the work
+void bignum_sqr(bignum_t* out, const bignum_t* a);
+void bignum_mul2(bignum_t* out, const bignum_t* a);
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdbool.h>
+#include <inttypes.h>
+
+#include <perturbation.h>
+
+// bilinear approximation on top of a reference orbit: while dz is small
+// enough, l perturbation steps starting at iteration m collapse into
+// dz_{m+l} = A dz_m + B dc. the table holds one such step per level and
+// position (level k skips 2^k iterations) together with the radius R it is
+// valid for, so a pixel can jump thousands of iterations in one multiply
+
+#define BLA_MAX_LEVELS 32
+
+// relative error a step may add to dz. neighbouring pixels' dz differ by
+// about pixel_size / |dc| relative to it, so an error of a small fraction
+// (BLA_PIXEL_TOLERANCE) of that leaves every pixel on its own value, however
+// far the plain loop's rounding is below it. the rounding of whatever the
+// deltas are iterated in is the floor
+#define BLA_PIXEL_TOLERANCE 0x1p-14
+#define BLA_EPSILON_DOUBLE 0x1p-53
+#define BLA_EPSILON_FLOAT 0x1p-24
+
+typedef struct {
+    double a_re, a_im;
+    double b_re, b_im;
+    double r;
+} bla_step_t;
+
+typedef struct {
+    const reference_orbit_t* ref;
+    // largest |dc| the radii were computed for; valid for any view whose
+    // pixels are all closer to the reference than this
+    double dc_max;
+    double epsilon;
+
+    uint32_t num_levels;
+    uint32_t level_offset[BLA_MAX_LEVELS];  // index of the first step of each level
+    uint32_t level_count[BLA_MAX_LEVELS];
+    bla_step_t* steps;
+    uint32_t num_steps;
+} bla_table_t;
+
+// the epsilon for a view with this pixel size and no pixel further than
+// dc_max from the reference; rounding is BLA_EPSILON_DOUBLE or _FLOAT
+double bla_epsilon(double pixel_size, double dc_max, double rounding);
+
+// level 0 entry j covers iteration j + 1 -> j + 2 (iteration 0 -> 1 is
+// dz = dc, no table needed); level k entry j covers 2^k iterations from
+// 1 + j * 2^k
+bla_table_t* bla_table_build(const reference_orbit_t* ref, double dc_max, double epsilon);
+void bla_table_destroy(bla_table_t* bla);
+
+// the same iteration count (or PERTURB_GLITCHED) as perturb_iterate(), give
+// or take rounding
+uint32_t bla_iterate(const bla_table_t* bla, double dcx, double dcy, uint32_t max_iter);
+void bla_row(const bla_table_t* bla, double dcx0, double dx, double dcy, uint32_t count, uint32_t max_iter, uint32_t* out_iter);
@@ -3,6 +3,7 @@
 #include <GLFW/glfw3.h>
 
 void resize_callback(GLFWwindow* window, int width, int height);
+void refresh_callback(GLFWwindow* window);
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
 void cursor_pos_callback(GLFWwindow* window, double x, double y);
 void mouse_button_callback(GLFWwindow* window, int button, int action, int mods);
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdbool.h>
+#include <inttypes.h>
+
+#include <mandelbrot.h>
+
+// where the view looks. the center is view_t's pan point (screen2ndc() = 0,
+// the middle of the window's lower-left square) as a double-double: hi + lo
+// with lo below half an ulp of hi, about 106 bits, so a drag deep in a zoom
+// moves it by what the pixels say instead of rounding away against |c| ~ 1.
+// zoom is kept as its base-2 log, so a long scroll session adds exponents
+// instead of compounding the rounding of zoom *= step. every backend builds
+// its view_t from one of these
+typedef struct {
+    double re_hi, re_lo;
+    double im_hi, im_lo;
+    double zoom_log2;       // zoom = 2^zoom_log2, see view_t
+} camera_t;
+
+void camera_init(camera_t* camera, double re, double im, double zoom);
+// the center from decimal strings with any number of digits, rounded to
+// double-double; false (and camera untouched) if either doesn't parse
+bool camera_set_center_decimal(camera_t* camera, const char* re, const char* im);
+
+double camera_zoom(const camera_t* camera);
+// zoom *= 2^log2_factor
+void camera_zoom_by(camera_t* camera, double log2_factor);
+// moves the center by (d_re, d_im) in the complex plane
+void camera_pan(camera_t* camera, double d_re, double d_im);
+// moves the center so the image follows a drag of (dx, dy) window pixels
+// (y down) in a width x height window
+void camera_drag(camera_t* camera, double dx, double dy, uint32_t width, uint32_t height);
+
+// what a width x height image of the camera maps its pixels to
+view_t camera_view(const camera_t* camera, uint32_t width, uint32_t height, uint32_t max_iter);
+// rect of the width x height image camera_view() would give, as a view of
+// its own whose pixels land on the same points; max_iter is kept as it is
+// rather than following the smaller view's zoom
+view_t camera_view_rect(const camera_t* camera, uint32_t width, uint32_t height, const pixel_rect_t* rect, uint32_t max_iter);
+// the camera looking at view's pan point and zoom
+void camera_from_view(camera_t* camera, const view_t* view);
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <stdbool.h>
+#include <inttypes.h>
+
+#include <bla.h>
+#include <kernels.h>
+#include <mandelbrot.h>
+#include <perturbation.h>
+#include <tile_scheduler.h>
+
+#define CPU_DEFAULT_TILE_SIZE 64
+#define CPU_DEFAULT_MAX_REFERENCES 32
+
+typedef enum {
+    SCHEDULE_STEAL,     // per-worker deques with work stealing (default)
+    SCHEDULE_STATIC,    // worker w renders tiles w, w + n, ...
+} schedule_t;
+
+typedef enum {
+    SUBDIVIDE_OFF,          // iterate every pixel, row by row
+    SUBDIVIDE_ON,           // mariani-silver, see cpu_renderer_set_subdivide()
+    // the same splits without filling anything, so every pixel comes out of
+    // the same kernel call SUBDIVIDE_ON would have iterated it with; what
+    // SUBDIVIDE_ON filled is checked against this
+    SUBDIVIDE_SPLIT_ONLY,
+} subdivide_t;
+
+// tightly packed RGB8, top row first (what image_write_ppm() expects)
+typedef struct {
+    uint32_t width, height;
+    uint8_t* pixels;
+} framebuffer_t;
+
+// raw escape counts, laid out like framebuffer_t; renders fill it and
+// cpu_renderer_colorize() turns it into colors
+typedef struct {
+    uint32_t width, height;
+    uint32_t max_iter;      // of the frame in it; counts >= max_iter are interior
+    uint32_t* iter;
+} iter_buffer_t;
+
+// glitch correction of the last cpu_renderer_render_rect() call, all zero
+// unless it was perturbed
+typedef struct {
+    uint32_t glitched;      // pixels the primary reference got wrong
+    uint32_t references;    // secondary references it took to redo them
+    uint32_t unresolved;    // still glitched when max_references ran out, drawn as interior
+} glitch_stats_t;
+
+// what a perturbed frame iterates against
+typedef struct {
+    const reference_orbit_t* ref;
+    const bla_table_t* bla;         // optional, built on ref
+    double ref_off_x, ref_off_y;    // pan point - reference point
+} perturb_frame_t;
+
+typedef struct cpu_renderer cpu_renderer_t;
+
+framebuffer_t* framebuffer_create(uint32_t width, uint32_t height);
+void framebuffer_destroy(framebuffer_t* fb);
+iter_buffer_t* iter_buffer_create(uint32_t width, uint32_t height);
+void iter_buffer_destroy(iter_buffer_t* iters);
+// moves pixel (x, y) to (x + dx, y + dy); what's shifted in is left as it was,
+// see view_exposed_rects() for where that is
+void iter_buffer_shift(iter_buffer_t* iters, int32_t dx, int32_t dy);
+
+// num_threads = 0 uses every core, tile_size = 0 uses CPU_DEFAULT_TILE_SIZE,
+// isa is resolved against what this CPU supports
+cpu_renderer_t* cpu_renderer_create(uint32_t num_threads, uint32_t tile_size, isa_t isa);
+void cpu_renderer_destroy(cpu_renderer_t* renderer);
+
+uint32_t cpu_renderer_num_threads(const cpu_renderer_t* renderer);
+
+// returns the isa actually used after resolving it
+isa_t cpu_renderer_set_isa(cpu_renderer_t* renderer, isa_t isa);
+void cpu_renderer_set_schedule(cpu_renderer_t* renderer, schedule_t schedule);
+// mariani-silver: iterate each tile's border and fill it in if it's all one
+// count, otherwise split it and repeat. much faster on views that are mostly
+// interior or wide escape bands, but a filament thinner than a pixel can
+// slip through a border unseen (default SUBDIVIDE_OFF)
+void cpu_renderer_set_subdivide(cpu_renderer_t* renderer, subdivide_t subdivide);
+// points inside the main cardioid or the period-2 bulb are interior without
+// iterating them, see mandelbrot_in_main_bulbs() (default on)
+void cpu_renderer_set_bulb_check(cpu_renderer_t* renderer, bool bulb_check);
+// cycle detection in the kernels: an orbit that returns within tolerance
+// pixels of itself is interior, see mandelbrot_iterate_periodic(). 0 turns
+// it off (default PERIOD_DEFAULT_TOLERANCE)
+void cpu_renderer_set_period_tolerance(cpu_renderer_t* renderer, double tolerance);
+// stealing stats of the last SCHEDULE_STEAL frame
+const tile_scheduler_t* cpu_renderer_scheduler(const cpu_renderer_t* renderer);
+
+// how many secondary references a perturbed frame may compute to redo its
+// glitched pixels; 0 only counts them (default CPU_DEFAULT_MAX_REFERENCES)
+void cpu_renderer_set_max_references(cpu_renderer_t* renderer, uint32_t max_references);
+const glitch_stats_t* cpu_renderer_glitch_stats(const cpu_renderer_t* renderer);
+
+// the kernel a frame of view would run on; ISA_SCALAR once float runs out
+isa_t cpu_renderer_frame_isa(const cpu_renderer_t* renderer, const view_t* view);
+
+// renders only rect of view into iters, leaving the rest of it as it was;
+// perturb = NULL iterates plainly, otherwise as cpu_renderer_render_perturbed()
+void cpu_renderer_render_rect(cpu_renderer_t* renderer, const view_t* view, const perturb_frame_t* perturb, const pixel_rect_t* rect, iter_buffer_t* iters);
+
+// renders view's iteration counts into iters, which must be view->width x
+// view->height
+void cpu_renderer_render(cpu_renderer_t* renderer, const view_t* view, iter_buffer_t* iters);
+
+// deep zoom: every pixel iterates its delta against ref, skipping ahead with
+// bla if it isn't NULL (it must be built on ref). ref_off is the pan point
+// minus the reference point (0 when ref was computed at the pan point).
+// glitched pixels are then redone, and only they, against secondary
+// references picked from among them
+void cpu_renderer_render_perturbed(cpu_renderer_t* renderer, const view_t* view, const reference_orbit_t* ref, const bla_table_t* bla, double ref_off_x, double ref_off_y, iter_buffer_t* iters);
+
+// colors iters into fb (same size) with palette; no iterating, so it's cheap
+// enough to redo on every palette change
+void cpu_renderer_colorize(cpu_renderer_t* renderer, const iter_buffer_t* iters, const palette_t* palette, framebuffer_t* fb);
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdbool.h>
+#include <inttypes.h>
+
+// the tile queues of the compute escape pass (shader/escape.comp): pass 0
+// lays ESCAPE_TILE_SIZE tiles over a rect, and every pass after that
+// takes the tiles the one before split, with glDispatchComputeIndirect()
+// straight from the queue's counter, down to ESCAPE_MIN_TILE. the queues
+// are two SSBOs used by turns
+#define ESCAPE_TILE_SIZE 32
+#define ESCAPE_MIN_TILE 8
+
+// a rect is run a chunk of this many tiles each way at a time, so the
+// last pass's queue fits in one dispatch (at least 65535 groups)
+#define ESCAPE_CHUNK_TILES_X 64
+#define ESCAPE_CHUNK_TILES_Y 63
+
+typedef struct {
+    uint32_t queues[2];
+} gl_escape_compute_t;
+
+void gl_escape_compute_init(gl_escape_compute_t* ec);
+void gl_escape_compute_destroy(gl_escape_compute_t* ec);
+
+// the escape pass over grid points (x0, y0) to (x1, y1) exclusive, rows
+// bottom up, with the compute program in use and its other uniforms set.
+// rect_loc and first_pass_loc are its u_rect and u_first_pass
+void gl_escape_compute_run(gl_escape_compute_t* ec, int32_t rect_loc, int32_t first_pass_loc, uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1);
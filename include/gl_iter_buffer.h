@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdbool.h>
+#include <inttypes.h>
+
+// the escape pass (shader/main.frag) writes into an RG32F texture instead
+// of the screen: r = iteration count, g = smooth escape value. the colorize
+// pass (shader/colorize.frag) reads it back, so palette changes redraw
+// without iterating anything. there are two textures so a pan can copy the
+// still-visible part of one into the other; current is the one holding the
+// last frame
+typedef struct {
+    // no attachments: the escape pass imageStore()s into texture[current],
+    // since progressive refinement draws a smaller viewport than it fills
+    uint32_t fbo;
+    uint32_t texture[2];
+    uint32_t current;
+    uint32_t width, height;
+} gl_iter_buffer_t;
+
+void gl_iter_buffer_init(gl_iter_buffer_t* buffer, uint32_t width, uint32_t height);
+void gl_iter_buffer_destroy(gl_iter_buffer_t* buffer);
+
+// binds texture[current] to image unit 0 and fbo for the escape pass
+void gl_iter_buffer_bind(const gl_iter_buffer_t* buffer);
+
+// reallocates the textures for a new window size; returns whether it had to.
+// the contents are undefined afterwards
+bool gl_iter_buffer_resize(gl_iter_buffer_t* buffer, uint32_t width, uint32_t height);
+
+// moves pixel (x, y) to (x + dx, y + dy), y = 0 the top row like
+// iter_buffer_shift(); what's shifted in is undefined until it's rendered
+void gl_iter_buffer_shift(gl_iter_buffer_t* buffer, int32_t dx, int32_t dy);
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <inttypes.h>
+
+// per-stage frame timings for the interactive window: CPU time from
+// glfwGetTime() around each stage of the render block, and GPU time from a
+// GL_TIMESTAMP query at either end of it. the queries go into one of
+// PROFILER_QUERY_SETS sets per frame and are only read back once
+// GL_QUERY_RESULT_AVAILABLE says so, so the profiler never waits on the GPU;
+// a frame whose results aren't in by the time its set comes round again
+// keeps its CPU times and loses the GPU ones.
+//
+// the overlay draws the last PROFILER_HISTORY frames in the bottom left
+// corner: one column per frame, CPU stage times stacked in the top half and
+// GPU ones in the bottom half (up to 33 ms, a line every 8.3 ms), and next to
+// it a histogram of whole-frame CPU times in 1 ms buckets. stage colors are
+// in gl_profiler.c's STAGE_COLORS
+
+typedef enum {
+    PROFILER_STAGE_PREPARE,     // variant choice and reference orbit upload
+    PROFILER_STAGE_UNIFORMS,    // escape pass uniforms
+    PROFILER_STAGE_ESCAPE,      // escape pass draws
+    PROFILER_STAGE_COLORIZE,    // colorize pass, uniforms included
+    PROFILER_STAGE_OVERLAY,     // this overlay
+    PROFILER_STAGE_SWAP,        // glfwSwapBuffers(), CPU only
+    PROFILER_STAGE_COUNT,
+} profiler_stage_t;
+
+// frames whose queries can be in flight at once: double buffering, plus
+// one for drivers that queue a frame further ahead
+#define PROFILER_QUERY_SETS 3
+#define PROFILER_HISTORY 240
+#define PROFILER_BUCKETS 48     // 1 ms each, the last one takes everything longer
+
+typedef struct {
+    uint64_t frame;
+    uint32_t ran;       // bit per stage that ran this frame
+    double cpu_ms[PROFILER_STAGE_COUNT];
+    double gpu_ms[PROFILER_STAGE_COUNT];    // < 0 = not measured
+    double frame_ms;    // CPU, gl_profiler_frame_begin() to gl_profiler_frame_end()
+} profiler_frame_t;
+
+typedef struct {
+    bool enabled;       // overlay or csv; off = every call returns right away
+    bool show;          // draw the overlay
+    FILE* csv;          // a row per frame once its GPU times are in, NULL = none
+
+    uint32_t queries[PROFILER_QUERY_SETS][PROFILER_STAGE_COUNT][2];
+    // the frame each set's queries belong to, waiting for the GPU
+    profiler_frame_t pending[PROFILER_QUERY_SETS];
+    bool set_pending[PROFILER_QUERY_SETS];
+
+    uint64_t frame_no;
+    uint32_t set;       // the current frame's
+    profiler_frame_t current;
+    double frame_start;
+    double stage_start[PROFILER_STAGE_COUNT];
+
+    profiler_frame_t history[PROFILER_HISTORY];
+    uint32_t history_next;
+    uint32_t history_count;
+
+    // overlay
+    uint32_t program;
+    uint32_t texture;
+    int32_t uni_loc_data, uni_loc_origin, uni_loc_columns, uni_loc_colors;
+} gl_profiler_t;
+
+// csv_path NULL = no csv. program draws the overlay (shader/profiler.frag)
+bool gl_profiler_init(gl_profiler_t* profiler, const char* csv_path, uint32_t program);
+void gl_profiler_destroy(gl_profiler_t* profiler);
+
+// shows or hides the overlay; profiling runs while either it's shown or
+// there's a csv
+void gl_profiler_show(gl_profiler_t* profiler, bool show);
+
+// around each frame that draws; begin also reads back whichever earlier
+// frames' queries are ready
+void gl_profiler_frame_begin(gl_profiler_t* profiler);
+void gl_profiler_frame_end(gl_profiler_t* profiler);
+
+// around each stage, at most once per frame. each one is also a trace.h
+// scope, profiling or not
+void gl_profiler_begin(gl_profiler_t* profiler, profiler_stage_t stage);
+void gl_profiler_end(gl_profiler_t* profiler, profiler_stage_t stage);
+
+// the overlay, onto whatever framebuffer is bound, with the window's size.
+// uses the bound VAO's quad and leaves the viewport at the whole window
+void gl_profiler_draw(gl_profiler_t* profiler, uint32_t window_width, uint32_t window_height);
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <inttypes.h>
+#include <pthread.h>
+
+#include <bla.h>
+#include <mandelbrot.h>
+#include <perturbation.h>
+#include <reference_cache.h>
+
+// keeps a reference orbit for the shader's perturbation path in an SSBO
+// (binding 0, the reference_orbit block in main.frag). the orbit is only
+// recomputed when the view has moved off it, zoomed past its precision or
+// asked for more iterations than it has. its BLA table goes in a second SSBO
+// (binding 1, bla_steps) and is rebuilt with the orbit, or when the view has
+// grown past the dc_max it was built for.
+//
+// a deep orbit can take seconds, so it's computed on a thread of its own
+// while the window keeps the last frame up; gl_reference_computing() says
+// when that is and how far along it is.
+//
+// orbits the view moves off (finished or cut short) go to a reference_cache_t
+// rather than away, and a new one is looked for there before it's computed;
+// one that's found but too short is carried on from where it stopped
+typedef struct {
+    uint32_t ssbo;
+    reference_orbit_t* ref;
+    reference_cache_t* cache;   // not owned, may be NULL
+
+    // the orbit on its way; pending is only touched by the thread until
+    // pending_done is set. it starts out as a cached orbit to extend, or NULL
+    bool computing;
+    pthread_t thread;
+    reference_progress_t progress;
+    atomic_bool pending_done;
+    reference_orbit_t* pending;
+    bignum_t* pending_c_re;
+    bignum_t* pending_c_im;
+    uint32_t pending_precision_bits;
+    uint32_t pending_max_iter;
+
+    uint32_t bla_ssbo;
+    bla_table_t* bla;
+
+    // glitched pixel counter (binding 2, glitch_counter)
+    uint32_t glitch_ssbo;
+} gl_reference_t;
+
+void gl_reference_init(gl_reference_t* glref, reference_cache_t* cache);
+void gl_reference_destroy(gl_reference_t* glref);
+
+// zero the glitch counter before a perturbed frame, read it back after; the
+// read waits for the frame to finish, so don't do it every frame
+void gl_reference_reset_glitched(gl_reference_t* glref);
+uint32_t gl_reference_glitched(const gl_reference_t* glref);
+
+// starts computing a new orbit if the current one can't serve view (and the
+// one being computed couldn't either), and uploads it once it's done. a
+// cached orbit that serves view as it is goes up straight away.
+// returns whether a new orbit went up this call
+bool gl_reference_update(gl_reference_t* glref, const view_t* view);
+// whether an orbit is still being computed, so the perturbed path has none to
+// use yet; if so and out_fraction isn't NULL, how far it has got (0-1)
+bool gl_reference_computing(const gl_reference_t* glref, double* out_fraction);
+
+// view's pan point minus the reference point, worked out in bignums: past
+// double's depth pan_x - c_re_d would round the whole picture off by pixels
+void gl_reference_offset(const gl_reference_t* glref, const view_t* view, double* out_dx, double* out_dy);
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <inttypes.h>
+
+#include <options.h>
+
+// --backend=cpu: renders with the CPU engine and reports timings, no window
+// and no GL context. returns the process exit code
+int32_t headless_run(const options_t* opts);
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stdbool.h>
+#include <inttypes.h>
+
+#include <cpu_render.h>
+
+// binary PPM (P6), the least ceremony way to get a framebuffer onto disk
+bool image_write_ppm(const char* filename, const framebuffer_t* fb);
+
+// writes an image top row first, a band of rows at a time, so an export far
+// bigger than memory never has to be held whole. the format follows the
+// extension: .png (deflated with zlib), .tif/.tiff (uncompressed BigTIFF in
+// strips, so past 4 GB too) or PPM for anything else. memory use is a row or
+// so whatever the image size
+typedef struct image_writer image_writer_t;
+
+// NULL if filename can't be created
+image_writer_t* image_writer_open(const char* filename, uint32_t width, uint32_t height);
+// the next rows->height rows; rows->width has to be the image's width
+bool image_writer_write(image_writer_t* writer, const framebuffer_t* rows);
+// finishes the file; false if it or any write before it failed, or if fewer
+// rows than the image's height were written
+bool image_writer_close(image_writer_t* writer);
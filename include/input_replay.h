@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <inttypes.h>
+
+#include <GLFW/glfw3.h>
+
+#include <camera.h>
+
+// the scroll, cursor and mouse button events going into callbacks.c, logged
+// with their times so a session can be played back into the same callbacks,
+// either at the recorded pace or one event per frame as fast as the frames
+// go. either way every event's latency, from the callback taking it to the
+// first glfwSwapBuffers() showing what it did, is kept for the report.
+//
+// the log is text: a header with the window size and the starting camera
+// (doubles as %a, so a replay starts from exactly the same view), then one
+// event per line. all state is global, like callbacks.c's
+
+typedef enum {
+    INPUT_EVENT_SCROLL,         // x, y offsets
+    INPUT_EVENT_CURSOR_POS,     // x, y position
+    INPUT_EVENT_MOUSE_BUTTON,   // button, action, mods
+} input_event_type_t;
+
+typedef struct {
+    double time;                // seconds since recording started
+    input_event_type_t type;
+    double x, y;
+    int32_t button, action, mods;
+} input_event_t;
+
+// writes every event callbacks.c sees from now on to path
+bool input_record_start(const char* path, uint32_t width, uint32_t height, const camera_t* camera);
+
+// reads a log for input_replay_pump(); out_width, out_height and out_camera
+// get what it was recorded with. fast = one event per frame instead of the
+// recorded pace
+bool input_replay_load(const char* path, bool fast, uint32_t* out_width, uint32_t* out_height, camera_t* out_camera);
+bool input_replaying();
+// every event fed and shown
+bool input_replay_finished();
+// feeds the events that are due through callbacks.c. returns how long until
+// the next one is, for the main loop's wait (0 = now, < 0 = nothing left)
+double input_replay_pump(GLFWwindow* window);
+
+// callbacks.c, after handling an event; does nothing unless recording or
+// replaying
+void input_event_handled(const input_event_t* event);
+// main loop, right after a glfwSwapBuffers() that shows every event so far
+void input_frame_presented();
+
+// each event's latency and a summary, then stops recording or replaying
+void input_report(FILE* out);
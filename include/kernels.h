@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdbool.h>
+#include <inttypes.h>
+
+#include <mandelbrot.h>
+
+// escape-time kernels for the CPU backend, one per instruction set. the
+// scalar one iterates in double like mandelbrot_iterate(); the SIMD ones
+// iterate in float. while kernel_float_precision_ok() holds, float still
+// tells neighbouring pixels apart, so the image has the same detail, but
+// counts near the boundary can differ from the double ones by rounding
+
+typedef enum {
+    ISA_AUTO,       // best one the CPU supports
+    ISA_SCALAR,     // plain C, double precision
+    ISA_SSE2,       // 4 float lanes
+    ISA_AVX2,       // 8 float lanes
+    ISA_AVX512,     // 16 float lanes
+    ISA_COUNT,
+} isa_t;
+
+// iterates the points (cx0 + k * dx, cy) for k in [0, count) and writes
+// their iteration counts into out_iter. period_eps > 0 turns on cycle
+// detection, see mandelbrot_iterate_periodic()
+typedef void (*escape_row_fn)(double cx0, double dx, double cy, uint32_t count, uint32_t max_iter, double period_eps, uint32_t* out_iter);
+// the same down a column: the points (cx, cy0 + k * dy), counts still
+// packed into out_iter[k]
+typedef void (*escape_column_fn)(double cx, double cy0, double dy, uint32_t count, uint32_t max_iter, double period_eps, uint32_t* out_iter);
+
+const char* isa_name(isa_t isa);
+// "auto", "scalar", "sse2", "avx2" or "avx512" -> isa, false if unknown
+bool isa_from_name(const char* name, isa_t* out_isa);
+
+// checked with CPUID once, at first use
+bool isa_supported(isa_t isa);
+isa_t isa_best_supported();
+// resolves ISA_AUTO and falls back to the best supported one below isa
+isa_t isa_resolve(isa_t isa);
+
+uint32_t isa_lanes(isa_t isa);
+escape_row_fn kernel_for_isa(isa_t isa);
+escape_column_fn column_kernel_for_isa(isa_t isa);
+
+// whether neighbouring pixels are still distinct in float; past that point
+// the float kernels produce blocks and the renderer has to use ISA_SCALAR
+bool kernel_float_precision_ok(const view_t* view);
+// same for double; past that point only perturbation gives a usable image
+bool kernel_double_precision_ok(const view_t* view);
+// the same for any arithmetic that rounds to a relative epsilon
+bool kernel_precision_ok(const view_t* view, double epsilon);
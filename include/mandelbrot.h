@@ -0,0 +1,100 @@
+#pragma once
+
+#include <stdbool.h>
+#include <inttypes.h>
+
+// CPU mirror of the escape-time math in shader/main.frag and the coloring in
+// shader/colorize.frag. Anything changed here has to be changed there too
+// (and vice versa), otherwise the CPU and GLSL backends stop producing the
+// same image.
+
+#define COLOR_START_R 59
+#define COLOR_START_G 24
+#define COLOR_START_B 119
+#define COLOR_END_R 218
+#define COLOR_END_G 90
+#define COLOR_END_B 42
+
+// what the view maps a pixel to, in the same terms as the shader uniforms:
+// c = screen2ndc(pixel) * zoom + (pan_x, pan_y)
+typedef struct {
+    uint32_t width, height;
+    double zoom;
+    double pan_x, pan_y;    // complex-plane offset, i.e. u_pan
+    // what pan_x, pan_y rounded off, so past double's depth the pan point
+    // is still exact (camera_view() fills them; 0 is fine anywhere shallow)
+    double pan_x_lo, pan_y_lo;
+    uint32_t max_iter;      // 0 = mandelbrot_max_iter(zoom)
+} view_t;
+
+// deep zooms get capped here instead of asking for billions of iterations
+// (and a reference orbit to match)
+#define MAX_ITER_CAP (1u << 22)
+
+// max_iter = int(2 / u_zoom + 100), capped at MAX_ITER_CAP
+uint32_t mandelbrot_max_iter(double zoom);
+uint32_t view_max_iter(const view_t* view);
+
+// number of iterations before |z| > 2, or max_iter if it never escapes
+uint32_t mandelbrot_iterate(double cx, double cy, uint32_t max_iter);
+
+// the same, but an orbit that comes back within period_eps of the z saved at
+// the last power of two iteration has settled into a cycle (brent's
+// method) and returns max_iter right away. period_eps = 0 never checks
+uint32_t mandelbrot_iterate_periodic(double cx, double cy, uint32_t max_iter, double period_eps);
+
+// how close an orbit has to come back to itself, in pixels, for
+// mandelbrot_iterate_periodic() to call it a cycle; scaled by the pixel
+// size so it tightens as the view zooms in
+#define PERIOD_DEFAULT_TOLERANCE 1e-2
+
+// closed-form membership in the main cardioid or the period-2 bulb, which
+// between them hold most of the interior at the default view. in_main_bulbs()
+// in main.frag is the same test
+bool mandelbrot_in_main_bulbs(double cx, double cy);
+
+// how iteration counts become colors; applied in a pass of its own
+// (shader/colorize.frag, cpu_renderer_colorize()), so changing it never
+// re-iterates anything
+typedef struct {
+    uint8_t start[3];   // color at iteration 0
+    uint8_t end[3];     // color at max_iter - 1
+    float exposure;     // stretches the ramp, 1 = iter / (max_iter - 1) as is
+    bool smooth;        // gl only: continuous escape values instead of whole iterations
+} palette_t;
+
+#define PALETTE_COUNT 3
+
+// preset index % PALETTE_COUNT at exposure 1, not smooth; 0 is
+// COLOR_START -> COLOR_END
+palette_t palette_preset(uint32_t index);
+
+// start -> end ease_out_expo ramp, black for interior points
+void palette_colorize(const palette_t* palette, uint32_t iter, uint32_t max_iter, uint8_t* out_rgb);
+// same with palette_preset(0)
+void mandelbrot_colorize(uint32_t iter, uint32_t max_iter, uint8_t* out_rgb);
+
+// complex coordinate of the center of pixel (px, py); py = 0 is the top row
+void view_pixel_to_complex(const view_t* view, uint32_t px, uint32_t py, double* out_cx, double* out_cy);
+// same pixel relative to the pan point, i.e. screen2ndc(gl_FragCoord.xy) * u_zoom.
+// stays exact however deep the view is, which is what perturbation needs
+void view_pixel_to_delta(const view_t* view, uint32_t px, uint32_t py, double* out_dx, double* out_dy);
+// the other way: where a delta from the pan point lands, in pixels with
+// pixel centers on whole numbers (so not necessarily inside the view)
+void view_delta_to_pixel(const view_t* view, double dx, double dy, double* out_px, double* out_py);
+// distance between neighbouring pixels in the complex plane
+double view_pixel_size(const view_t* view);
+
+// [x0, x1) x [y0, y1) in pixels, y = 0 is the top row
+typedef struct {
+    uint32_t x0, y0;
+    uint32_t x1, y1;
+} pixel_rect_t;
+
+// whether to is from panned by a whole number of pixels (same size, zoom and
+// max_iter), so from's pixel (x, y) is to's (x + dx, y + dy)
+bool view_pixel_shift(const view_t* from, const view_t* to, int32_t* out_dx, int32_t* out_dy);
+// what a (dx, dy) shift of a width x height image leaves uncovered: a full
+// height column and the rest of a row band, at most two rects. returns how
+// many it wrote to out_rects
+uint32_t view_exposed_rects(uint32_t width, uint32_t height, int32_t dx, int32_t dy, pixel_rect_t* out_rects);
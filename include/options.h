@@ -0,0 +1,93 @@
+#pragma once
+
+#include <stdbool.h>
+#include <inttypes.h>
+
+#include <cpu_render.h>
+#include <kernels.h>
+#include <mandelbrot.h>
+
+typedef enum {
+    BACKEND_GL,     // interactive window, shader/main.frag does the work
+    BACKEND_CPU,    // headless, never touches GLFW
+} backend_t;
+
+typedef enum {
+    REDRAW_ON_CHANGE,   // gl: draw only after pan, zoom or resize, sleep otherwise
+    REDRAW_ALWAYS,      // gl: draw as fast as possible, for fps measurements
+} redraw_t;
+
+typedef enum {
+    SHADER_PRECISION_AUTO,      // picked per frame by zoom and measured cost, see shader_policy.h
+    SHADER_PRECISION_FLOAT,
+    SHADER_PRECISION_DOUBLE_FLOAT,
+    SHADER_PRECISION_FP64,
+} shader_precision_t;
+
+typedef enum {
+    ESCAPE_FRAGMENT,    // shader/main.frag, one fragment per pixel
+    ESCAPE_COMPUTE,     // shader/escape.comp, by tiles, see gl_escape_compute.h
+} escape_pass_t;
+
+typedef enum {
+    PERTURB_AUTO,   // once double can't tell neighbouring pixels apart
+    PERTURB_ON,
+    PERTURB_OFF,
+} perturb_mode_t;
+
+typedef struct {
+    backend_t backend;
+    redraw_t redraw;
+    bool progressive;       // gl: coarse passes first, refined while nothing changes
+    shader_precision_t shader_precision;    // gl: what main.frag's plain loop runs on
+    escape_pass_t escape;   // gl: what runs main.frag's per-pixel code
+    const char* record;     // gl: log mouse input here, see input_replay.h
+    const char* replay;     // gl: play a log back instead of taking mouse input
+    bool replay_fast;       // gl: one replayed event per frame instead of the recorded pace
+    bool profile;           // gl: frame profiler overlay up from the start, see gl_profiler.h
+    const char* profile_csv;    // gl: per-frame stage timings go here, NULL = nowhere
+    const char* trace;      // Chrome trace of every thread written here at exit, see trace.h
+
+    uint32_t width, height;
+    double zoom;
+    double pan_x, pan_y;
+    // --pan exactly as typed, so deep zoom reference points keep every digit
+    const char* pan_re;
+    const char* pan_im;
+    uint32_t max_iter;      // 0 = 2 / zoom + 100
+    uint32_t palette;       // palette_preset() index
+    float exposure;
+    bool smooth;            // gl only, see palette_t
+    perturb_mode_t perturb;
+    bool bla;               // skip iterations with bilinear approximation when perturbing
+    bool bulb_check;        // main cardioid and period-2 bulb are interior without iterating
+    bool periodicity;       // interior orbits stop once they cycle
+    double period_tolerance;    // pixels, see mandelbrot_iterate_periodic()
+    uint32_t max_refs;      // secondary references per frame for glitched pixels
+    uint32_t ref_cache_mb;  // memory bound of the reference orbit cache
+    const char* ref_cache_dir;  // where orbits past it go, and persist; NULL = dropped
+
+    // CPU backend
+    uint32_t threads;       // 0 = all cores
+    uint32_t tile_size;     // 0 = CPU_DEFAULT_TILE_SIZE
+    uint32_t frames;        // how many times to render (for timing)
+    int32_t pan_step_x, pan_step_y;     // pixels each frame pans by
+    bool pan_reuse;         // shift the last frame and render only the exposed strips
+    subdivide_t subdivide;
+    bool subdivide_verify;  // also render without filling and report the pixels that differ
+    const char* output;     // PPM path, NULL = don't write anything
+    const char* export_path;    // render width x height a band at a time into this, see image_writer_t
+    // zoom video from video_start_zoom in to zoom, see zoom_video.h: a
+    // printf pattern for the frame files, or "-" for raw RGB24 on stdout
+    const char* video;
+    double video_start_zoom;
+    uint32_t frames_per_octave;     // frames per halving of the zoom
+    isa_t isa;
+    bool isa_bench;         // time every supported isa instead of rendering once
+    bool bulb_bench;        // time with bulb_check off and on instead of rendering once
+    schedule_t schedule;
+    bool sched_stats;       // print per-worker tile/steal counts after rendering
+} options_t;
+
+// fills opts from argv; prints usage and exits on anything it doesn't understand
+void options_parse(options_t* opts, int argc, char** argv);
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <inttypes.h>
+
+#include <bignum.h>
+
+// deep zoom by perturbation: one reference point C is iterated in bignum
+// precision, and every pixel c = C + dc only iterates its difference from
+// that orbit, dz' = 2 Z dz + dz^2 + dc, which stays small enough for double
+// (CPU) or float (shader) no matter how deep the view is
+
+typedef struct {
+    bignum_t* c_re;
+    bignum_t* c_im;
+    double c_re_d, c_im_d;      // C rounded, for pixels that outlive the orbit
+
+    uint32_t precision_bits;    // fraction bits, rounded up to whole limbs
+    uint32_t max_iter;          // what it was computed for (or got to before a cancel)
+
+    // Z_n as (re, im) pairs rounded to double, n in [0, length). stops at
+    // the first Z_n with |Z_n| > 2, or at max_iter
+    double* orbit;
+    uint32_t length;
+    bool escaped;
+
+    // Z_length in full precision, where reference_orbit_extend() carries on
+    // from; meaningless once escaped
+    bignum_t* z_re;
+    bignum_t* z_im;
+} reference_orbit_t;
+
+// returned instead of an iteration count when a pixel's delta has lost its
+// precision against the reference (Pauldelbrot's test: |Z + dz| got tiny
+// next to |Z|, so the digits that matter were cancelled out of dz). the
+// pixel has to be redone against a reference closer to it
+#define PERTURB_GLITCHED UINT32_MAX
+// on squared magnitudes: glitched once |Z + dz| < 1e-3 |Z|
+#define PERTURB_GLITCH_TOLERANCE 1e-6
+
+// fraction bits needed to resolve pixels of size pixel_size (plus guard bits)
+uint32_t perturb_precision_bits(double pixel_size);
+
+// iterates C = (c_re, c_im) up to max_iter at precision_bits; the bignums are
+// copied, so the caller keeps ownership of its own
+reference_orbit_t* reference_orbit_compute(const bignum_t* c_re, const bignum_t* c_im, uint32_t precision_bits, uint32_t max_iter);
+
+// lets another thread watch, and stop, an orbit being computed
+typedef struct {
+    atomic_uint iterations;     // Z_n done so far, updated every few thousand
+    atomic_bool cancel;         // set to stop early; the orbit ends wherever it got to
+} reference_progress_t;
+
+// reference_orbit_compute() for the one big orbit of a frame: once the
+// numbers are wide enough to be worth a handoff and there's a second core,
+// the cross term xy goes to a helper thread while this one squares x and y.
+// progress may be NULL
+reference_orbit_t* reference_orbit_compute_parallel(const bignum_t* c_re, const bignum_t* c_im, uint32_t precision_bits, uint32_t max_iter, reference_progress_t* progress);
+// carries an orbit that stopped short (at its max_iter, or cancelled) on to
+// max_iter, the same way; nothing to do if it escaped
+void reference_orbit_extend(reference_orbit_t* ref, uint32_t max_iter, reference_progress_t* progress);
+// a secondary reference at ref's C + (dcx, dcy), same precision
+reference_orbit_t* reference_orbit_offset(const reference_orbit_t* ref, double dcx, double dcy, uint32_t max_iter);
+void reference_orbit_destroy(reference_orbit_t* ref);
+
+// iteration count of C + (dcx, dcy) by iterating only its delta, or
+// PERTURB_GLITCHED
+uint32_t perturb_iterate(const reference_orbit_t* ref, double dcx, double dcy, uint32_t max_iter);
+
+// finishes a pixel that outlived the reference orbit: (zx, zy) is its last
+// iterate z_{i-1}, already known not to have escaped
+uint32_t perturb_finish(const reference_orbit_t* ref, double zx, double zy, double dcx, double dcy, uint32_t i, uint32_t max_iter);
+
+// escape_row_fn shape: the points are C + (dcx0 + k * dx, dcy)
+void perturb_row(const reference_orbit_t* ref, double dcx0, double dx, double dcy, uint32_t count, uint32_t max_iter, uint32_t* out_iter);
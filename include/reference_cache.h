@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <inttypes.h>
+
+#include <bignum.h>
+#include <bla.h>
+#include <perturbation.h>
+
+// reference orbits (with their BLA tables) kept around after the view has
+// moved off them, keyed by C and precision, so zooming back out and in again
+// over the same spot finds the orbit instead of recomputing it. an orbit
+// that's found but too short is extended rather than redone.
+//
+// entries past the memory bound go least recently used first (taking an
+// orbit and putting it back counts as a use): written to spill_dir if there
+// is one (and read back when wanted), dropped otherwise.
+// with a spill_dir, whatever is still in memory is written out on destroy
+// and the files are picked up again by the next cache on the same dir, so
+// orbits survive across runs too. not thread safe
+typedef struct reference_cache reference_cache_t;
+
+// spill_dir = NULL keeps everything in memory
+reference_cache_t* reference_cache_create(size_t max_bytes, const char* spill_dir);
+void reference_cache_destroy(reference_cache_t* cache);
+
+// takes the cached orbit with at least precision_bits whose C is within
+// max_distance of (c_re, c_im) on both axes (0 = exactly it), preferring the
+// longest, out of the cache; NULL if there's none. *out_bla gets its table,
+// if it was cached with one that still matches it
+reference_orbit_t* reference_cache_take(reference_cache_t* cache, const bignum_t* c_re, const bignum_t* c_im, double max_distance, uint32_t precision_bits, bla_table_t** out_bla);
+
+// hands ref (and bla, which may be NULL) to the cache, which may evict
+// anything, ref included, to stay under its bound
+void reference_cache_put(reference_cache_t* cache, reference_orbit_t* ref, bla_table_t* bla);
+
+typedef struct {
+    uint64_t hits;          // takes that found an orbit
+    uint64_t disk_hits;     // ... of which had to be read back from spill_dir
+    uint64_t misses;
+    uint64_t spills;        // orbits written to spill_dir
+    size_t bytes;           // held in memory right now
+} reference_cache_stats_t;
+
+reference_cache_stats_t reference_cache_stats(const reference_cache_t* cache);
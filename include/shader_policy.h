@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdbool.h>
+#include <inttypes.h>
+
+#include <mandelbrot.h>
+
+// which arithmetic shader/main.frag's plain escape loop runs on. float is
+// fastest but runs out around 1e-5 zoom; double-float (two floats per
+// value, PRECISION_DOUBLE_FLOAT) and fp64 (PRECISION_FP64) both go to about
+// 1e-13, and which of those is cheaper depends on the GPU: consumer cards
+// run fp64 at 1/32 or 1/64 rate, so emulating it on floats usually wins
+typedef enum {
+    SHADER_VARIANT_FLOAT,
+    SHADER_VARIANT_DOUBLE_FLOAT,
+    SHADER_VARIANT_FP64,
+    SHADER_VARIANT_COUNT,
+} shader_variant_t;
+
+// relative rounding of a double-float: hi and lo have 24 bits each
+#define DOUBLE_FLOAT_EPSILON 0x1p-48
+
+typedef struct {
+    bool available[SHADER_VARIANT_COUNT];
+    // moving average of GPU seconds per pixel iteration, 0 = not measured yet
+    double cost[SHADER_VARIANT_COUNT];
+} shader_policy_t;
+
+const char* shader_variant_name(shader_variant_t variant);
+
+// available is indexed by shader_variant_t; at least one has to be set
+void shader_policy_init(shader_policy_t* policy, const bool* available);
+
+// the cheapest available variant that can still tell view's pixels apart.
+// float always wins while it can; past that the candidates are compared by
+// measured cost, and one that hasn't been measured yet is tried first. if
+// none is precise enough, *out_precise is false and the most precise one is
+// returned: the perturbed path is float in every variant, so it doesn't
+// matter which one perturbs, and with perturbation off it's the best there is
+shader_variant_t shader_policy_choose(const shader_policy_t* policy, const view_t* view, bool* out_precise);
+
+// an escape pass with variant took seconds of GPU time for pixels pixels
+// at max_iter each
+void shader_policy_record(shader_policy_t* policy, shader_variant_t variant, double seconds, double pixels, uint32_t max_iter);
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <inttypes.h>
+
+// fixed set of worker threads that all run the same job together; the thread
+// calling thread_pool_run() takes part as worker 0
+typedef struct thread_pool thread_pool_t;
+
+typedef void (*thread_pool_fn)(void* ctx, uint32_t worker, uint32_t num_workers);
+
+// num_threads = 0 uses every online core
+thread_pool_t* thread_pool_create(uint32_t num_threads);
+void thread_pool_destroy(thread_pool_t* pool);
+
+uint32_t thread_pool_size(const thread_pool_t* pool);
+
+// runs fn on every worker and blocks until all of them have returned
+void thread_pool_run(thread_pool_t* pool, thread_pool_fn fn, void* ctx);
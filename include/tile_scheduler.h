@@ -0,0 +1,39 @@
+#pragma once
+
+#include <inttypes.h>
+
+// work-stealing scheduler for render tiles. every worker owns a Chase-Lev
+// deque: it pops its own tiles from the bottom, and once it runs dry it
+// steals from the top of somebody else's. tiles near the set boundary can
+// cost thousands of times more than exterior ones, so a static split leaves
+// most cores idle; this keeps them busy until the last tile is taken
+
+typedef struct tile_scheduler tile_scheduler_t;
+
+typedef void (*tile_fn)(void* ctx, uint32_t worker, uint32_t tile);
+
+typedef struct {
+    uint64_t tiles;             // tiles this worker ran
+    uint64_t steals;            // ... of which it stole from another deque
+    uint64_t failed_steals;     // steal attempts that found nothing or lost a race
+    double busy_time;           // seconds spent inside tile_fn
+} tile_worker_stats_t;
+
+tile_scheduler_t* tile_scheduler_create(uint32_t num_workers);
+void tile_scheduler_destroy(tile_scheduler_t* sched);
+
+// deals tiles [0, num_tiles) out to the workers in contiguous runs and
+// clears the stats. not thread safe: call it before the workers start
+void tile_scheduler_reset(tile_scheduler_t* sched, uint32_t num_tiles);
+
+// runs tiles until none are left anywhere; every worker calls this once
+void tile_scheduler_work(tile_scheduler_t* sched, uint32_t worker, tile_fn fn, void* ctx);
+
+// queues another tile from inside a tile_fn, e.g. to split an expensive one.
+// runs it right away if the worker's deque is full
+void tile_scheduler_push(tile_scheduler_t* sched, uint32_t worker, uint32_t tile, tile_fn fn, void* ctx);
+
+uint32_t tile_scheduler_num_workers(const tile_scheduler_t* sched);
+const tile_worker_stats_t* tile_scheduler_worker_stats(const tile_scheduler_t* sched, uint32_t worker);
+// sum over all workers (busy_time is the sum too)
+tile_worker_stats_t tile_scheduler_total_stats(const tile_scheduler_t* sched);
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdbool.h>
+
+// scoped events for chrome://tracing or Perfetto, from any thread. each
+// thread writes into a ring buffer of its own, so recording takes no lock
+// and nothing is shared but the list the buffers hang off, which only
+// grows. the newest TRACE_BUFFER_EVENTS events of every thread that
+// recorded any go to a Chrome trace JSON file when the process exits, so a
+// thread's buffer outlives it.
+//
+// until trace_start() every call here returns on its first load, so they
+// can stay in for good. all state is global, like input_replay.c's
+
+// events kept per thread; older ones are overwritten
+#define TRACE_BUFFER_EVENTS 16384
+
+// records from now on and writes path at exit; false if path can't be
+// created
+bool trace_start(const char* path);
+
+// what the trace calls the calling thread, instead of its number. name is
+// copied
+void trace_thread_name(const char* name);
+
+// a scope on the calling thread, ended by the next trace_end() there.
+// scopes nest; name has to stay valid until exit (a string literal)
+void trace_begin(const char* name);
+void trace_end();
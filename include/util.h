@@ -1,8 +1,17 @@
 #pragma once
 
+#include <stdbool.h>
 #include <inttypes.h>
 
-typedef uint8_t bool;
+// small helpers the viewer, the headless renderer and the benchmark share
 
-#define true ((bool) 0xFF)
-#define false ((bool) 0x00)
+// CLOCK_MONOTONIC in seconds
+double now_seconds();
+
+// qsort() comparator for doubles, ascending
+int compare_double(const void* a, const void* b);
+
+// "--name=value" -> value, NULL if arg isn't that flag
+const char* flag_value(const char* arg, const char* name);
+// the whole of s as a decimal uint32_t
+bool parse_u32(const char* s, uint32_t* out);
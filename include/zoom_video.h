@@ -0,0 +1,23 @@
+#pragma once
+
+#include <inttypes.h>
+
+#include <cpu_render.h>
+#include <mandelbrot.h>
+
+// frames of a zoom video made out of keyframes instead of rendered one by
+// one, the way KF and zoomasm do it: a keyframe per halving of the zoom, at
+// twice the frame size, and every frame in between cut out of them. the
+// outer keyframe (zoom >= the frame's) covers the whole frame at 1-2
+// keyframe pixels per frame pixel; the inner one (half its zoom) covers the
+// middle at 2-4, and is used wherever it reaches. so the rendering is per
+// octave of zoom, not per frame
+typedef struct {
+    view_t view;        // twice the frame's size, same pan point
+    const framebuffer_t* fb;
+} zoom_keyframe_t;
+
+// frame's pixels from outer and inner (which may be NULL); the three views
+// have to share their pan point, with inner->view.zoom <= frame zoom <=
+// outer->view.zoom
+void zoom_video_frame(const zoom_keyframe_t* outer, const zoom_keyframe_t* inner, const view_t* frame, framebuffer_t* out);
@@ -0,0 +1,38 @@
+#version 450 core
+
+// second pass: colors the iteration counts main.frag left in u_iterations.
+// nothing here iterates, so palette changes cost one cheap full-screen draw
+
+uniform sampler2D u_iterations;     // r = count, g = smooth count
+uniform uint u_max_iter;            // of the frame in u_iterations
+// only every u_stride-th pixel is there yet (progressive refinement); the
+// rest copy the one below and left of them
+uniform uint u_stride;
+uniform vec3 u_color_start;
+uniform vec3 u_color_end;
+uniform float u_exposure;
+uniform bool u_smooth;
+
+out vec3 color;
+
+vec3 lerp(vec3 a, vec3 b, float t) {
+    return a + (b - a) * t;
+}
+
+float ease_out_expo(float t) {
+    return (t == 1.f) ? 1.f : 1.f - pow(2.f, -10.f * t);
+}
+
+void main() {
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    pixel -= pixel % int(u_stride);
+    vec2 iterations = texelFetch(u_iterations, pixel, 0).rg;
+    if (iterations.r >= float(u_max_iter)) {
+        color = vec3(0.f, 0.f, 0.f);
+        return;
+    }
+
+    float i = u_smooth ? iterations.g : iterations.r;
+    float t = clamp(i / float(u_max_iter - 1) * u_exposure, 0.f, 1.f);
+    color = lerp(u_color_start, u_color_end, ease_out_expo(t));
+}
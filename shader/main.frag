@@ -1,12 +1,81 @@
-#version 460 core
+#version 450 core
+
+// src/main.c defines PRECISION_FP64 when the context has fp64: the pixel ->
+// c mapping and the plain escape loop then run on doubles, which resolve
+// pixels about 2^29 times smaller before perturbation has to take over
+//
+// PRECISION_DOUBLE_FLOAT gets to the same depth on floats alone, for GPUs
+// without fast fp64: c and z are unevaluated sums hi + lo of two floats
+// (see the df_ functions below), about 48 bits for a few times the cost
+#ifdef PRECISION_FP64
+#define real double
+#define real2 dvec2
+#else
+#define real float
+#define real2 vec2
+#endif
 
 uniform vec2 u_resolution;
-uniform vec2 u_pan;
-uniform float u_zoom;
+uniform real2 u_pan;        // c where screen2ndc() is 0, the camera's center (src/camera.c)
+uniform real u_zoom;
+uniform uint u_max_iter;    // 2 / u_zoom + 100, capped (see mandelbrot_max_iter)
+uniform bool u_bulb_check;  // skip the main cardioid and period-2 bulb
+// cycle detection as in mandelbrot_iterate_periodic(): squared distance an
+// orbit has to come back within to count as interior, 0 = off
+uniform float u_period_eps2;
+
+// deep zoom: instead of c, iterate the pixel's offset from a reference orbit
+// that the CPU computed in bignum precision (src/perturbation.c)
+uniform bool u_perturb;
+uniform uint u_ref_len;
+uniform vec2 u_ref_c;       // reference point, for pixels that outlive the orbit
+uniform vec2 u_ref_offset;  // pan point - reference point
+
+layout (std430, binding = 0) readonly buffer reference_orbit {
+    vec2 ref_orbit[];
+};
+
+// Pauldelbrot's glitch test, as in src/perturbation.c: |Z + dz|^2 below
+// this times |Z|^2 means dz lost the digits that mattered
+#define PERTURB_GLITCH_TOLERANCE 1e-6f
+#define PERTURB_GLITCHED 0xFFFFFFFFu
+
+// glitched pixels this frame, cleared and read back by src/gl_reference.c
+layout (std430, binding = 2) buffer glitch_counter {
+    uint glitched;
+};
+// whether the last pixel_escape_value() was one of them
+bool pixel_glitched = false;
+
+// bilinear approximation of the same orbit (src/bla.c): step k of level l
+// takes dz from iteration 1 + k * 2^l to 2^l iterations later as
+// a dz + b dc, valid while |dz| < r.x
+#define BLA_MAX_LEVELS 32
+uniform uint u_bla_levels;
+uniform uint u_bla_offset[BLA_MAX_LEVELS];
+uniform uint u_bla_count[BLA_MAX_LEVELS];
 
-out vec3 color;
+struct bla_step {
+    vec2 a;
+    vec2 b;
+    vec2 r;
+};
 
-vec2 screen2ndc(vec2 screen_coords) {
+layout (std430, binding = 1) readonly buffer bla_steps {
+    bla_step bla[];
+};
+
+// escape pass: (iteration count, smooth escape value) per pixel into the
+// iteration buffer (src/gl_iter_buffer.c); shader/colorize.frag colors it
+layout (rg32f, binding = 0) uniform writeonly image2D u_iterations;
+
+// progressive refinement (src/main.c): the pass draws a u_stride times
+// smaller viewport and each fragment does pixel (x, y) * u_stride. when
+// u_refine is set the previous pass already did every other one of those
+uniform uint u_stride;
+uniform bool u_refine;
+
+real2 screen2ndc(real2 screen_coords) {
     return (screen_coords / u_resolution - 0.5f) * 2.f;
 }
 
@@ -14,17 +83,7 @@ vec2 ndc2screen(vec2 ndc_coords) {
     return ((ndc_coords / 2.f) + .5f) * u_resolution;
 }
 
-vec3 lerp(vec3 a, vec3 b, float t) {
-    return a + (b - a) * t;
-}
-
-float ease_out_expo(float t) {
-    return (t == 1.f) ? 1.f : 1.f - pow(2.f, -10.f * t);
-}
-
 #define MAX_ITER uint(100)
-#define COLOR_START (vec3(59.f, 24.f, 119.f) / 255.f)
-#define COLOR_END (vec3(218.f, 90.f, 42.f) / 255.f)
 
 vec2 complex_square(vec2 z) {
     float za = z.x * z.x;
@@ -36,16 +95,233 @@ vec2 complex_square(vec2 z) {
     return vec2(as, bs);
 }
 
-vec3 mandelbrot_color(vec2 c) {
+vec2 complex_mul(vec2 a, vec2 b) {
+    return vec2(a.x * b.x - a.y * b.y, a.x * b.y + a.y * b.x);
+}
+
+// (i, continuous i) for a point that escaped at iteration i with z; the
+// continuous one runs from i + 1 down to i as |z| goes from 2 to 4
+vec2 escape_value(uint i, uint max_iter, vec2 z) {
+    if (i >= max_iter) {
+        return vec2(float(max_iter), float(max_iter));
+    }
+
+    return vec2(float(i), float(i) + 1.f - log2(log2(length(z))));
+}
+
+// how many iterations the table can skip from iteration i (0 if none), with
+// the step in out_step. a level's radius is never bigger than the one below
+// it, so the walk up ends at the first miss
+uint bla_skip(uint i, float dz2, uint max_iter, out bla_step out_step) {
+    uint j0 = i - 1;
+    uint top = (j0 == 0) ? uint(BLA_MAX_LEVELS) : uint(findLSB(j0));
+    uint best = 0;
+
+    for (uint l = 1; l <= top && l < u_bla_levels; l++) {
+        uint j = j0 >> l;
+        uint skip = 1u << l;
+        if (j >= u_bla_count[l] || i + skip >= u_ref_len || i + skip > max_iter) { break; }
+
+        bla_step step = bla[u_bla_offset[l] + j];
+        if (dz2 >= step.r.x * step.r.x) { break; }
+        out_step = step;
+        best = skip;
+    }
+    return best;
+}
+
+// dz' = 2 Z dz + dz^2 + dc, escape test on the full z = Z + dz. returns
+// PERTURB_GLITCHED if the pixel needs a different reference, z is the
+// first escaped iterate
+uint perturbed_iterations(vec2 dc, uint max_iter, out vec2 z) {
+    uint limit = min(max_iter, u_ref_len);
+    vec2 dz = vec2(0.f, 0.f);
+    z = vec2(0.f, 0.f);
+    uint i = 0;
+
+    while (i < limit) {
+        vec2 ref_z = ref_orbit[i];
+        z = ref_z + dz;
+        float z2 = dot(z, z);
+        if (z2 > 4.f) { return i; }
+        if (z2 < PERTURB_GLITCH_TOLERANCE * dot(ref_z, ref_z)) { return PERTURB_GLITCHED; }
+
+        bla_step step;
+        uint skip = (i > 0) ? bla_skip(i, dot(dz, dz), max_iter, step) : 0;
+        if (skip > 0) {
+            dz = complex_mul(step.a, dz) + complex_mul(step.b, dc);
+            i += skip;
+            continue;
+        }
+
+        dz = 2.f * complex_mul(ref_z, dz) + complex_square(dz) + dc;
+        i++;
+    }
+    if (i >= max_iter) { return max_iter; }
+
+    // the reference escaped first, finish on plain floats
+    vec2 c = u_ref_c + dc;
+    z = complex_square(z) + c;
+    for (; i < max_iter; i++) {
+        if (z.x * z.x + z.y * z.y > 4.f) { break; }
+        z = complex_square(z) + c;
+    }
+    return i;
+}
+
+#ifdef PRECISION_DOUBLE_FLOAT
+// the same mapping as u_pan and u_zoom, split on the CPU into hi + lo
+uniform vec4 u_pan_df;      // (re hi, re lo, im hi, im lo)
+uniform vec2 u_zoom_df;
+
+// error-free transformations: the rounding error of one float operation is
+// itself a float, so it can be carried along in lo. precise keeps the
+// compiler from reassociating or fusing them, which would cancel the error
+// terms out
+
+// knuth's two-sum: s + e == a + b exactly
+vec2 two_sum(float a, float b) {
+    precise float s = a + b;
+    precise float v = s - a;
+    precise float e = (a - (s - v)) + (b - v);
+    return vec2(s, e);
+}
+
+// the same when |a| >= |b|, in half the operations
+vec2 quick_two_sum(float a, float b) {
+    precise float s = a + b;
+    precise float e = b - (s - a);
+    return vec2(s, e);
+}
+
+// veltkamp's split into two 12-bit halves, whose products are exact
+vec2 df_split(float a) {
+    precise float t = 4097.f * a;
+    precise float hi = t - (t - a);
+    precise float lo = a - hi;
+    return vec2(hi, lo);
+}
+
+// dekker's two-product: p + e == a * b exactly
+vec2 two_prod(float a, float b) {
+    precise float p = a * b;
+    vec2 as = df_split(a);
+    vec2 bs = df_split(b);
+    precise float e = ((as.x * bs.x - p) + as.x * bs.y + as.y * bs.x) + as.y * bs.y;
+    return vec2(p, e);
+}
+
+vec2 df_add(vec2 a, vec2 b) {
+    vec2 s = two_sum(a.x, b.x);
+    vec2 t = two_sum(a.y, b.y);
+    s = quick_two_sum(s.x, s.y + t.x);
+    return quick_two_sum(s.x, s.y + t.y);
+}
+
+vec2 df_mul(vec2 a, vec2 b) {
+    vec2 p = two_prod(a.x, b.x);
+    return quick_two_sum(p.x, p.y + (a.x * b.y + a.y * b.x));
+}
+
+vec2 df_mul_f(vec2 a, float b) {
+    vec2 p = two_prod(a.x, b);
+    return quick_two_sum(p.x, p.y + a.y * b);
+}
+
+vec2 df_sqr(vec2 a) {
+    vec2 p = two_prod(a.x, a.x);
+    return quick_two_sum(p.x, p.y + 2.f * a.x * a.y);
+}
+
+// in_main_bulbs() on double-floats: near the cardioid's edge the hi parts
+// alone would pull exterior pixels inside
+bool in_main_bulbs_df(vec2 cx, vec2 cy) {
+    vec2 y2 = df_sqr(cy);
+
+    vec2 xq = df_add(cx, vec2(-.25f, 0.f));
+    vec2 q = df_add(df_sqr(xq), y2);
+    vec2 lhs = df_mul(q, df_add(q, xq));
+    if (df_add(lhs, -.25f * y2).x <= 0.f) {
+        return true;
+    }
+
+    vec2 xb = df_add(cx, vec2(1.f, 0.f));
+    return df_add(df_add(df_sqr(xb), y2), vec2(-.0625f, 0.f)).x <= 0.f;
+}
+
+// mandelbrot_iterations() with z and c as (hi, lo) pairs per component. the
+// escape test only needs the hi parts, the cycle test needs both: orbits
+// that far in differ only in lo
+vec2 mandelbrot_iterations_df(vec2 cx, vec2 cy) {
     uint i;
-    vec2 z = vec2(0.f, 0.f);
+    vec2 zx = vec2(0.f, 0.f);
+    vec2 zy = vec2(0.f, 0.f);
+
+    uint max_iter = u_max_iter;
+    if (u_bulb_check && in_main_bulbs_df(cx, cy)) {
+        return escape_value(max_iter, max_iter, vec2(0.f, 0.f));
+    }
 
-    int max_iter = int(2 / u_zoom + 100);
+    vec2 saved_x = vec2(0.f, 0.f);
+    vec2 saved_y = vec2(0.f, 0.f);
+    uint next_save = 1;
+
+    for (i = 0; i < max_iter; i++) {
+        if (zx.x * zx.x + zy.x * zy.x > 4.f) { break; }
+
+        vec2 zxy = df_mul(zx, zy);
+        zx = df_add(df_add(df_sqr(zx), -df_sqr(zy)), cx);
+        // doubling is exact
+        zy = df_add(2.f * zxy, cy);
+
+        if (u_period_eps2 > 0.f) {
+            // the hi parts are close, so their difference is exact
+            vec2 e = vec2((zx.x - saved_x.x) + (zx.y - saved_x.y), (zy.x - saved_y.x) + (zy.y - saved_y.y));
+            if (dot(e, e) < u_period_eps2) {
+                return escape_value(max_iter, max_iter, vec2(zx.x, zy.x));
+            }
+            if (i + 1 == next_save) {
+                saved_x = zx;
+                saved_y = zy;
+                next_save *= 2;
+            }
+        }
+    }
+
+    return escape_value(i, max_iter, vec2(zx.x, zy.x));
+}
+#endif
+
+// main cardioid or period-2 bulb, as mandelbrot_in_main_bulbs()
+bool in_main_bulbs(real2 c) {
+    real y2 = c.y * c.y;
+
+    real xq = c.x - .25f;
+    real q = xq * xq + y2;
+    if (q * (q + xq) <= .25f * y2) {
+        return true;
+    }
+
+    real xb = c.x + 1.f;
+    return xb * xb + y2 <= .0625f;
+}
+
+vec2 mandelbrot_iterations(real2 c) {
+    uint i;
+    real2 z = real2(0.f, 0.f);
+
+    uint max_iter = u_max_iter;
+    if (u_bulb_check && in_main_bulbs(c)) {
+        return escape_value(max_iter, max_iter, vec2(z));
+    }
+
+    real2 saved = real2(0.f, 0.f);
+    uint next_save = 1;
 
     for (i = 0; i < max_iter; i++) {
         if (z.x * z.x + z.y * z.y > 4.f) { break; }
 
-        vec2 z_new = z;
+        real2 z_new = z;
         z_new.x = z.x * z.x - z.y * z.y;
         z_new.y = 2.f * z.x * z.y;
 
@@ -53,20 +329,50 @@ vec3 mandelbrot_color(vec2 c) {
 
         z.x = z_new.x;
         z.y = z_new.y;
-    }
 
-    if (i == max_iter) {
-        return vec3(0.f, 0.f, 0.f);
+        if (u_period_eps2 > 0.f) {
+            real2 e = z - saved;
+            if (dot(e, e) < u_period_eps2) {
+                return escape_value(max_iter, max_iter, vec2(z));
+            }
+            if (i + 1 == next_save) {
+                saved = z;
+                next_save *= 2;
+            }
+        }
     }
 
-    // return COLOR_END;
-
-    return lerp(COLOR_START, COLOR_END, ease_out_expo(float(i) / (max_iter - 1)));
-    // return lerp(COLOR_START, COLOR_END, float(i) / (MAX_ITER - 1));
+    // log2 has no double overload, and |z| > 2 doesn't need one
+    return escape_value(i, max_iter, vec2(z));
 }
 
-void main() {
-    vec2 xy = (screen2ndc(gl_FragCoord.xy) * u_zoom) + screen2ndc(u_pan);
+// (count, smooth count) of the pixel at window coordinates pixel, rows
+// bottom up, in whichever precision this variant runs
+vec2 pixel_escape_value(ivec2 pixel) {
+    vec2 frag_coord = vec2(pixel) + .5f;
+    pixel_glitched = false;
+
+    if (u_perturb) {
+        vec2 dc = vec2(screen2ndc(real2(frag_coord)) * u_zoom) + u_ref_offset;
+        vec2 z;
+        uint i = perturbed_iterations(dc, u_max_iter, z);
+        if (i == PERTURB_GLITCHED) {
+            // only counted here, drawn as interior
+            atomicAdd(glitched, 1u);
+            pixel_glitched = true;
+            i = u_max_iter;
+        }
+        return escape_value(i, u_max_iter, z);
+    }
+
+#ifdef PRECISION_DOUBLE_FLOAT
+    // ndc only has to be good to a fraction of a pixel, so it stays float
+    vec2 ndc = screen2ndc(frag_coord);
+    vec2 cx = df_add(df_mul_f(u_zoom_df, ndc.x), u_pan_df.xy);
+    vec2 cy = df_add(df_mul_f(u_zoom_df, ndc.y), u_pan_df.zw);
+    return mandelbrot_iterations_df(cx, cy);
+#else
+    real2 xy = (screen2ndc(real2(frag_coord)) * u_zoom) + u_pan;
     // vec2 colorxy = (xy + 1.f) / 2.f;
 
     // if (xy.x < -1.f || xy.y < -1.f || xy.x >= 1.f || xy.y >= 1.f) {
@@ -75,5 +381,19 @@ void main() {
     //     color = vec3(colorxy, 1.f);
     //     color = mandelbrot_color(xy);
     // }
-    color = mandelbrot_color(xy);
-}
\ No newline at end of file
+    return mandelbrot_iterations(xy);
+#endif
+}
+
+// src/main.c compiles this file a second time with ESCAPE_COMPUTE defined
+// and shader/escape.comp after it, whose main() does the same by tiles
+#ifndef ESCAPE_COMPUTE
+void main() {
+    ivec2 grid = ivec2(gl_FragCoord.xy);
+    if (u_refine && (grid.x & 1) == 0 && (grid.y & 1) == 0) {
+        return;
+    }
+    ivec2 pixel = grid * int(u_stride);
+    imageStore(u_iterations, pixel, vec4(pixel_escape_value(pixel), 0.f, 0.f));
+}
+#endif
@@ -0,0 +1,62 @@
+#version 450 core
+
+// the frame profiler overlay (src/gl_profiler.c), drawn into a viewport
+// that covers just the panel. left: a column per frame, newest on the
+// right, CPU stage times stacked up from the middle and GPU ones down from
+// it. right: histogram of whole-frame CPU times
+
+// same as include/gl_profiler.h
+#define PROFILER_STAGE_COUNT 6
+#define PROFILER_HISTORY 240
+#define PROFILER_BUCKETS 48
+
+// same as src/gl_profiler.c
+#define HALF_HEIGHT 80
+#define GRAPH_MS 33.33333f
+#define GAP 8
+#define BUCKET_WIDTH 2
+
+// r, row s < PROFILER_STAGE_COUNT: CPU ms of stage s; the next
+// PROFILER_STAGE_COUNT rows: GPU ms, < 0 = not measured; last row: bucket
+// heights, 0 to 1
+uniform sampler2D u_data;
+uniform vec2 u_origin;      // bottom left of the panel, in window pixels
+uniform int u_columns;      // frames in u_data so far, right aligned
+uniform vec3 u_colors[PROFILER_STAGE_COUNT];
+
+out vec4 color;
+
+void main() {
+    ivec2 p = ivec2(gl_FragCoord.xy - u_origin);
+    color = vec4(0.f, 0.f, 0.f, .6f);
+
+    if (p.x < PROFILER_HISTORY) {
+        bool gpu = p.y < HALF_HEIGHT;
+        float ms = float(gpu ? HALF_HEIGHT - 1 - p.y : p.y - HALF_HEIGHT) * (GRAPH_MS / float(HALF_HEIGHT));
+
+        if (p.x >= PROFILER_HISTORY - u_columns) {
+            int first_row = gpu ? PROFILER_STAGE_COUNT : 0;
+            float sum = 0.f;
+            for (int s = 0; s < PROFILER_STAGE_COUNT; s++) {
+                sum += max(texelFetch(u_data, ivec2(p.x, first_row + s), 0).r, 0.f);
+                if (ms < sum) {
+                    color = vec4(u_colors[s], 1.f);
+                    return;
+                }
+            }
+        }
+        // 120, 60 and 40 fps
+        float pixel_ms = GRAPH_MS / float(HALF_HEIGHT);
+        if (mod(ms + .5f * pixel_ms, GRAPH_MS / 4.f) < pixel_ms && ms > pixel_ms) {
+            color = vec4(.5f, .5f, .5f, .8f);
+        }
+    } else if (p.x < PROFILER_HISTORY + GAP) {
+        color = vec4(0.f);
+    } else {
+        int bucket = (p.x - PROFILER_HISTORY - GAP) / BUCKET_WIDTH;
+        float height = texelFetch(u_data, ivec2(bucket, 2 * PROFILER_STAGE_COUNT), 0).r;
+        if (float(p.y) < height * float(2 * HALF_HEIGHT)) {
+            color = vec4(.9f, .9f, .9f, 1.f);
+        }
+    }
+}
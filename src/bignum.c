@@ -0,0 +1,382 @@
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <inttypes.h>
+#include <ctype.h>
+#include <math.h>
+
+#include <bignum.h>
+
+#define INT_LIMB(a) ((a)->num_limbs - 1)
+
+static int mag_cmp(const uint32_t* a, const uint32_t* b, uint32_t n) {
+    for (uint32_t i = n; i-- > 0;) {
+        if (a[i] != b[i]) {
+            return (a[i] < b[i]) ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+// carry out of the integer limb is dropped
+static void mag_add(uint32_t* out, const uint32_t* a, const uint32_t* b, uint32_t n) {
+    uint64_t carry = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        uint64_t t = (uint64_t) a[i] + b[i] + carry;
+        out[i] = (uint32_t) t;
+        carry = t >> 32;
+    }
+}
+
+// needs a >= b
+static void mag_sub(uint32_t* out, const uint32_t* a, const uint32_t* b, uint32_t n) {
+    uint64_t borrow = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        uint64_t t = (uint64_t) a[i] - b[i] - borrow;
+        out[i] = (uint32_t) t;
+        borrow = (t >> 32) & 1;
+    }
+}
+
+// returns the carry out of the top limb
+static uint32_t mag_mul_small(uint32_t* a, uint32_t n, uint32_t k) {
+    uint64_t carry = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        uint64_t t = (uint64_t) a[i] * k + carry;
+        a[i] = (uint32_t) t;
+        carry = t >> 32;
+    }
+    return (uint32_t) carry;
+}
+
+static void mag_add_small(uint32_t* a, uint32_t n, uint32_t k) {
+    uint64_t carry = k;
+    for (uint32_t i = 0; i < n && carry; i++) {
+        uint64_t t = (uint64_t) a[i] + carry;
+        a[i] = (uint32_t) t;
+        carry = t >> 32;
+    }
+}
+
+static void mag_div_small(uint32_t* a, uint32_t n, uint32_t k) {
+    uint64_t rem = 0;
+    for (uint32_t i = n; i-- > 0;) {
+        uint64_t t = (rem << 32) | a[i];
+        a[i] = (uint32_t) (t / k);
+        rem = t % k;
+    }
+}
+
+static bool mag_is_zero(const uint32_t* a, uint32_t n) {
+    for (uint32_t i = 0; i < n; i++) {
+        if (a[i]) { return false; }
+    }
+    return true;
+}
+
+uint32_t bignum_limbs_for_bits(uint32_t precision_bits) {
+    return (precision_bits + BIGNUM_LIMB_BITS - 1) / BIGNUM_LIMB_BITS + 1;
+}
+
+bignum_t* bignum_create(uint32_t num_limbs) {
+    bignum_t* a = malloc(sizeof(*a));
+    a->num_limbs = num_limbs;
+    a->negative = false;
+    a->limbs = calloc(num_limbs, sizeof(uint32_t));
+    return a;
+}
+
+void bignum_destroy(bignum_t* a) {
+    free(a->limbs);
+    free(a);
+}
+
+void bignum_copy(bignum_t* out, const bignum_t* a) {
+    if (out == a) { return; }
+
+    // line the integer limbs up; extra fraction limbs are dropped or zeroed
+    uint32_t n = (a->num_limbs < out->num_limbs) ? a->num_limbs : out->num_limbs;
+    memset(out->limbs, 0, out->num_limbs * sizeof(uint32_t));
+    memcpy(&out->limbs[out->num_limbs - n], &a->limbs[a->num_limbs - n], n * sizeof(uint32_t));
+    out->negative = a->negative && !mag_is_zero(out->limbs, out->num_limbs);
+}
+
+void bignum_set_zero(bignum_t* out) {
+    out->negative = false;
+    memset(out->limbs, 0, out->num_limbs * sizeof(uint32_t));
+}
+
+void bignum_set_double(bignum_t* out, double v) {
+    bignum_set_zero(out);
+    out->negative = v < 0.;
+
+    // peel off 32 bits at a time; every step is exact in double
+    double x = fabs(v);
+    for (uint32_t i = out->num_limbs; i-- > 0 && x != 0.;) {
+        double limb = floor(x);
+        out->limbs[i] = (uint32_t) limb;
+        x = (x - limb) * 4294967296.;
+    }
+
+    if (mag_is_zero(out->limbs, out->num_limbs)) {
+        out->negative = false;
+    }
+}
+
+bool bignum_set_decimal(bignum_t* out, const char* s) {
+    uint32_t n = out->num_limbs;
+
+    bool negative = false;
+    if (*s == '-' || *s == '+') {
+        negative = *s == '-';
+        s++;
+    }
+
+    const char* int_digits = s;
+    while (isdigit((unsigned char) *s)) { s++; }
+    const char* int_end = s;
+
+    const char* frac_digits = s;
+    const char* frac_end = s;
+    if (*s == '.') {
+        frac_digits = ++s;
+        while (isdigit((unsigned char) *s)) { s++; }
+        frac_end = s;
+    }
+    if (int_end == int_digits && frac_end == frac_digits) {
+        return false;
+    }
+
+    // strtol() would also skip spaces, so the digits are checked first
+    long exponent = 0;
+    bool exponent_overflow = false;
+    if (*s == 'e' || *s == 'E') {
+        const char* e = s + 1;
+        if (!isdigit((unsigned char) e[(*e == '-' || *e == '+') ? 1 : 0])) {
+            return false;
+        }
+        char* end;
+        errno = 0;
+        exponent = strtol(e, &end, 10);
+        exponent_overflow = errno == ERANGE;
+        s = end;
+    }
+    if (*s != '\0') {
+        return false;
+    }
+
+    // the value is every digit as one integer D, times 10^scale
+    uint32_t num_digits = 0;
+    for (const char* d = int_digits; d < frac_end; d++) {
+        if (d == int_end) {
+            continue;
+        }
+        if (num_digits > 0 || *d != '0') {
+            num_digits++;
+        }
+    }
+    if (num_digits == 0) {
+        bignum_set_zero(out);
+        return true;
+    }
+    if (exponent_overflow) {
+        // too big to hold, or too small to show up at any precision
+        if (exponent > 0) {
+            return false;
+        }
+        bignum_set_zero(out);
+        return true;
+    }
+    long long scale = (long long) exponent - (long long) (frac_end - frac_digits);
+
+    // D < 10^num_digits, so the result is below 10^(num_digits + scale).
+    // anything from 10^10 up can't fit the integer limb, and below
+    // 10^(-9.6 per fraction limb) nothing is left of it
+    long long magnitude = (long long) num_digits + scale;
+    if (magnitude > 10) {
+        return false;
+    }
+    if (magnitude < -10 * (long long) n) {
+        bignum_set_zero(out);
+        return true;
+    }
+
+    // D goes into integer limbs of its own above the fraction ones, then
+    // comes down by 10^-scale, at most 9 digits at a time
+    uint32_t int_limbs = num_digits / 9 + 1;
+    uint32_t m = (n - 1) + int_limbs;
+    uint32_t* mag = calloc(m, sizeof(uint32_t));
+    uint32_t* int_part = &mag[n - 1];
+    for (const char* d = int_digits; d < frac_end; d++) {
+        if (d == int_end) {
+            continue;
+        }
+        mag_mul_small(int_part, int_limbs, 10);
+        mag_add_small(int_part, int_limbs, (uint32_t) (*d - '0'));
+    }
+
+    bool ok = true;
+    for (; scale > 0 && ok; scale--) {
+        ok = mag_mul_small(mag, m, 10) == 0;
+    }
+    while (scale < 0) {
+        uint32_t digits = (scale < -9) ? 9 : (uint32_t) -scale;
+        uint32_t divisor = 1;
+        for (uint32_t k = 0; k < digits; k++) { divisor *= 10; }
+        mag_div_small(mag, m, divisor);
+        scale += digits;
+    }
+    // whatever is left above the integer limb doesn't fit
+    ok = ok && mag_is_zero(&mag[n], m - n);
+
+    if (ok) {
+        memcpy(out->limbs, mag, n * sizeof(uint32_t));
+        out->negative = negative && !mag_is_zero(mag, n);
+    }
+    free(mag);
+    return ok;
+}
+
+double bignum_to_double(const bignum_t* a) {
+    uint32_t top = a->num_limbs;
+    while (top > 0 && a->limbs[top - 1] == 0) { top--; }
+
+    // the leading limb and the two below it cover the 53 bit mantissa
+    double v = 0.;
+    for (uint32_t i = (top >= 3) ? top - 3 : 0; i < top; i++) {
+        v += ldexp((double) a->limbs[i], 32 * ((int) i - (int) INT_LIMB(a)));
+    }
+    return a->negative ? -v : v;
+}
+
+int bignum_to_decimal(const bignum_t* a, uint32_t num_digits, char* out, size_t out_size) {
+    uint32_t n = a->num_limbs;
+    uint32_t frac[n];
+    memcpy(frac, a->limbs, n * sizeof(uint32_t));
+    frac[n - 1] = 0;
+
+    char digits[num_digits + 1];
+    uint32_t len = 0;
+    while (len < num_digits && !mag_is_zero(frac, n)) {
+        mag_mul_small(frac, n, 10);
+        digits[len++] = (char) ('0' + frac[n - 1]);
+        frac[n - 1] = 0;
+    }
+    digits[len] = '\0';
+
+    return snprintf(
+        out, out_size, "%s%" PRIu32 "%s%s",
+        a->negative ? "-" : "", a->limbs[n - 1], len ? "." : "", digits
+    );
+}
+
+bool bignum_is_zero(const bignum_t* a) {
+    return mag_is_zero(a->limbs, a->num_limbs);
+}
+
+static void signed_add(bignum_t* out, const bignum_t* a, const bignum_t* b, bool b_negative) {
+    uint32_t n = a->num_limbs;
+
+    if (a->negative == b_negative) {
+        mag_add(out->limbs, a->limbs, b->limbs, n);
+        out->negative = b_negative;
+    } else if (mag_cmp(a->limbs, b->limbs, n) >= 0) {
+        bool negative = a->negative;
+        mag_sub(out->limbs, a->limbs, b->limbs, n);
+        out->negative = negative;
+    } else {
+        mag_sub(out->limbs, b->limbs, a->limbs, n);
+        out->negative = b_negative;
+    }
+
+    if (out->negative && mag_is_zero(out->limbs, n)) {
+        out->negative = false;
+    }
+}
+
+void bignum_add(bignum_t* out, const bignum_t* a, const bignum_t* b) {
+    signed_add(out, a, b, b->negative);
+}
+
+void bignum_sub(bignum_t* out, const bignum_t* a, const bignum_t* b) {
+    signed_add(out, a, b, !b->negative);
+}
+
+void bignum_mul(bignum_t* out, const bignum_t* a, const bignum_t* b) {
+    uint32_t n = a->num_limbs;
+    uint32_t frac = n - 1;
+    uint32_t product[2 * n];
+    memset(product, 0, sizeof(product));
+
+    for (uint32_t i = 0; i < n; i++) {
+        if (a->limbs[i] == 0) { continue; }
+
+        uint64_t carry = 0;
+        for (uint32_t j = 0; j < n; j++) {
+            uint64_t t = (uint64_t) a->limbs[i] * b->limbs[j] + product[i + j] + carry;
+            product[i + j] = (uint32_t) t;
+            carry = t >> 32;
+        }
+        product[i + n] = (uint32_t) carry;
+    }
+
+    // 2 * frac fraction limbs in the product, keep the top frac of them
+    bool negative = a->negative != b->negative;
+    memcpy(out->limbs, &product[frac], n * sizeof(uint32_t));
+    out->negative = negative && !mag_is_zero(out->limbs, n);
+}
+
+void bignum_sqr(bignum_t* out, const bignum_t* a) {
+    uint32_t n = a->num_limbs;
+    uint32_t frac = n - 1;
+    uint32_t product[2 * n];
+    memset(product, 0, sizeof(product));
+
+    // a_i a_j for i < j, each once; row i's carry lands past anything the
+    // rows before it wrote
+    for (uint32_t i = 0; i < n; i++) {
+        if (a->limbs[i] == 0) { continue; }
+
+        uint64_t carry = 0;
+        for (uint32_t j = i + 1; j < n; j++) {
+            uint64_t t = (uint64_t) a->limbs[i] * a->limbs[j] + product[i + j] + carry;
+            product[i + j] = (uint32_t) t;
+            carry = t >> 32;
+        }
+        product[i + n] = (uint32_t) carry;
+    }
+
+    // doubled, which can't overflow: the off-diagonal sum is below a^2 / 2
+    uint32_t shifted_out = 0;
+    for (uint32_t k = 0; k < 2 * n; k++) {
+        uint32_t limb = product[k];
+        product[k] = (limb << 1) | shifted_out;
+        shifted_out = limb >> 31;
+    }
+
+    // plus the diagonal a_i^2 at limb 2i
+    uint64_t carry = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        uint64_t d = (uint64_t) a->limbs[i] * a->limbs[i];
+        uint64_t lo = (uint64_t) product[2 * i] + (uint32_t) d + carry;
+        product[2 * i] = (uint32_t) lo;
+        uint64_t hi = (uint64_t) product[2 * i + 1] + (d >> 32) + (lo >> 32);
+        product[2 * i + 1] = (uint32_t) hi;
+        carry = hi >> 32;
+    }
+
+    memcpy(out->limbs, &product[frac], n * sizeof(uint32_t));
+    out->negative = false;
+}
+
+void bignum_mul2(bignum_t* out, const bignum_t* a) {
+    uint32_t carry = 0;
+    for (uint32_t i = 0; i < a->num_limbs; i++) {
+        uint32_t limb = a->limbs[i];
+        out->limbs[i] = (limb << 1) | carry;
+        carry = limb >> 31;
+    }
+    out->negative = a->negative;
+}
@@ -0,0 +1,169 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <math.h>
+
+#include <bla.h>
+#include <perturbation.h>
+#include <trace.h>
+
+// x first, then y: dz -> A_y (A_x dz + B_x dc) + B_y dc. x's result has to
+// land inside y's radius for every |dc| up to dc_max
+static bla_step_t bla_merge(const bla_step_t* x, const bla_step_t* y, double dc_max) {
+    bla_step_t out;
+    out.a_re = y->a_re * x->a_re - y->a_im * x->a_im;
+    out.a_im = y->a_re * x->a_im + y->a_im * x->a_re;
+    out.b_re = y->a_re * x->b_re - y->a_im * x->b_im + y->b_re;
+    out.b_im = y->a_re * x->b_im + y->a_im * x->b_re + y->b_im;
+
+    double x_a = hypot(x->a_re, x->a_im);
+    double x_b = hypot(x->b_re, x->b_im);
+    double y_r = y->r - x_b * dc_max;
+
+    double y_r_through_x;
+    if (y_r <= 0.) {
+        y_r_through_x = 0.;
+    } else if (x_a > 0.) {
+        y_r_through_x = y_r / x_a;
+    } else {
+        y_r_through_x = INFINITY;
+    }
+
+    out.r = fmin(x->r, y_r_through_x);
+    return out;
+}
+
+double bla_epsilon(double pixel_size, double dc_max, double rounding) {
+    return fmax(BLA_PIXEL_TOLERANCE * pixel_size / dc_max, rounding);
+}
+
+bla_table_t* bla_table_build(const reference_orbit_t* ref, double dc_max, double epsilon) {
+    trace_begin("build BLA");
+    bla_table_t* bla = calloc(1, sizeof(*bla));
+    bla->ref = ref;
+    bla->dc_max = dc_max;
+    bla->epsilon = epsilon;
+
+    // level sizes first, so everything goes into one allocation
+    uint32_t count = (ref->length >= 2) ? ref->length - 1 : 0;
+    while (count > 0 && bla->num_levels < BLA_MAX_LEVELS) {
+        bla->level_offset[bla->num_levels] = bla->num_steps;
+        bla->level_count[bla->num_levels] = count;
+        bla->num_steps += count;
+        bla->num_levels++;
+        count /= 2;
+    }
+    bla->steps = malloc((size_t) bla->num_steps * sizeof(bla_step_t));
+
+    // level 0: dz_{m+1} = 2 Z_m dz_m + dc, dropping dz^2, which is fine while
+    // |dz| < epsilon |2 Z_m|
+    for (uint32_t j = 0; j < bla->level_count[0]; j++) {
+        double ref_x = ref->orbit[2 * (j + 1)];
+        double ref_y = ref->orbit[2 * (j + 1) + 1];
+
+        bla->steps[j] = (bla_step_t) {
+            .a_re = 2. * ref_x,
+            .a_im = 2. * ref_y,
+            .b_re = 1.,
+            .b_im = 0.,
+            .r = epsilon * 2. * hypot(ref_x, ref_y),
+        };
+    }
+
+    for (uint32_t k = 1; k < bla->num_levels; k++) {
+        const bla_step_t* prev = &bla->steps[bla->level_offset[k - 1]];
+        bla_step_t* level = &bla->steps[bla->level_offset[k]];
+
+        for (uint32_t j = 0; j < bla->level_count[k]; j++) {
+            level[j] = bla_merge(&prev[2 * j], &prev[2 * j + 1], dc_max);
+        }
+    }
+
+    trace_end();
+    return bla;
+}
+
+void bla_table_destroy(bla_table_t* bla) {
+    free(bla->steps);
+    free(bla);
+}
+
+// biggest table step that starts at iteration m, fits before the end of the
+// orbit and max_iter, and has dz inside its radius; NULL if none does. a
+// level's radius never exceeds the one below it at the same start (merging
+// takes the min), so the walk up stops at the first miss
+static const bla_step_t* bla_lookup(const bla_table_t* bla, uint32_t m, double dz2, uint32_t max_iter, uint32_t* out_skip) {
+    uint32_t j0 = m - 1;
+    // level k only has entries starting at multiples of 2^k
+    uint32_t top = j0 ? (uint32_t) __builtin_ctz(j0) : BLA_MAX_LEVELS;
+    const bla_step_t* best = NULL;
+
+    // level 0 saves nothing over a real perturbation step
+    for (uint32_t k = 1; k <= top && k < bla->num_levels; k++) {
+        uint32_t j = j0 >> k;
+        uint32_t skip = 1u << k;
+        if (j >= bla->level_count[k] || m + skip >= bla->ref->length || m + skip > max_iter) {
+            break;
+        }
+
+        const bla_step_t* step = &bla->steps[bla->level_offset[k] + j];
+        if (dz2 >= step->r * step->r) {
+            break;
+        }
+        best = step;
+        *out_skip = skip;
+    }
+    return best;
+}
+
+uint32_t bla_iterate(const bla_table_t* bla, double dcx, double dcy, uint32_t max_iter) {
+    const reference_orbit_t* ref = bla->ref;
+    const double* orbit = ref->orbit;
+    uint32_t limit = (max_iter < ref->length) ? max_iter : ref->length;
+    double dzx = 0., dzy = 0.;
+    double zx = 0., zy = 0.;
+    uint32_t m = 0;
+
+    while (m < limit) {
+        double ref_x = orbit[2 * m];
+        double ref_y = orbit[2 * m + 1];
+
+        zx = ref_x + dzx;
+        zy = ref_y + dzy;
+        double z2 = zx * zx + zy * zy;
+        if (z2 > 4.) { return m; }
+        if (z2 < PERTURB_GLITCH_TOLERANCE * (ref_x * ref_x + ref_y * ref_y)) { return PERTURB_GLITCHED; }
+
+        uint32_t skip;
+        const bla_step_t* step = (m > 0 && bla->num_levels > 1)
+            ? bla_lookup(bla, m, dzx * dzx + dzy * dzy, max_iter, &skip)
+            : NULL;
+
+        if (step) {
+            double new_dzx = step->a_re * dzx - step->a_im * dzy + step->b_re * dcx - step->b_im * dcy;
+            double new_dzy = step->a_re * dzy + step->a_im * dzx + step->b_re * dcy + step->b_im * dcx;
+            dzx = new_dzx;
+            dzy = new_dzy;
+            m += skip;
+            continue;
+        }
+
+        double new_dzx = 2. * (ref_x * dzx - ref_y * dzy) + (dzx * dzx - dzy * dzy) + dcx;
+        double new_dzy = 2. * (ref_x * dzy + ref_y * dzx) + 2. * dzx * dzy + dcy;
+        dzx = new_dzx;
+        dzy = new_dzy;
+        m++;
+    }
+
+    if (m >= max_iter) {
+        return max_iter;
+    }
+
+    return perturb_finish(ref, zx, zy, dcx, dcy, m, max_iter);
+}
+
+void bla_row(const bla_table_t* bla, double dcx0, double dx, double dcy, uint32_t count, uint32_t max_iter, uint32_t* out_iter) {
+    for (uint32_t k = 0; k < count; k++) {
+        out_iter[k] = bla_iterate(bla, dcx0 + k * dx, dcy, max_iter);
+    }
+}
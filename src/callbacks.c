@@ -6,33 +6,84 @@
 #include <GLFW/glfw3.h>
 
 #include <callbacks.h>
-#include <util.h>
+#include <camera.h>
+#include <input_replay.h>
+#include <trace.h>
 
-#define ZOOM_AMT ((float) 0.9f)
+#define ZOOM_AMT 0.9
+#define EXPOSURE_STEP ((float) 1.25f)
 
 extern float window_width;
 extern float window_height;
-extern float zoom;
-extern float x_off, y_off;
+extern camera_t camera;
+extern uint32_t palette_index;
+extern float exposure;
+extern uint8_t smooth_coloring;
+extern uint8_t show_profiler;
+
+// set whenever pan, zoom or size change; main() clears it when it draws
+uint8_t view_dirty = true;
+// set when only the coloring changed, which doesn't need re-iterating
+uint8_t palette_dirty = false;
 
 float mouse_x, mouse_y;
 float drag_prev_x = -1, drag_prev_y = -1;
 uint8_t is_dragging = false;
 
 void resize_callback(GLFWwindow* window, int width, int height) {
+    trace_begin("resize");
     glViewport(0, 0, width, height);
 
     window_width = width;
     window_height = height;
+    view_dirty = true;
+    trace_end();
+}
+
+void refresh_callback(GLFWwindow* window) {
+    // the window was uncovered or similar; the back buffer has to be redrawn
+    view_dirty = true;
 }
 
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
-    return;
+    if (action != GLFW_PRESS && action != GLFW_REPEAT) {
+        return;
+    }
+    trace_begin("key");
+
+    switch (key) {
+    case GLFW_KEY_P:
+        palette_index++;
+        break;
+    case GLFW_KEY_S:
+        smooth_coloring = !smooth_coloring;
+        break;
+    case GLFW_KEY_LEFT_BRACKET:
+        exposure /= EXPOSURE_STEP;
+        break;
+    case GLFW_KEY_RIGHT_BRACKET:
+        exposure *= EXPOSURE_STEP;
+        break;
+    case GLFW_KEY_T:
+        show_profiler = !show_profiler;
+        break;
+    default:
+        trace_end();
+        return;
+    }
+    palette_dirty = true;
+    trace_end();
 }
 
 void scroll_callback(GLFWwindow* window, double x, double y) {
+    trace_begin("scroll");
     // printf("scrolled %.3lf\n", y);
-    zoom *= pow(ZOOM_AMT, y);
+    camera_zoom_by(&camera, y * log2(ZOOM_AMT));
+    if (y != 0.) {
+        view_dirty = true;
+    }
+    input_event_handled(&(input_event_t) { .type = INPUT_EVENT_SCROLL, .x = x, .y = y });
+    trace_end();
     // zoom -= ZOOM_AMT * (float) y;
     // if (zoom <= 0.1f) {
     //     zoom = 0.1f;
@@ -40,6 +91,7 @@ void scroll_callback(GLFWwindow* window, double x, double y) {
 }
 
 void cursor_pos_callback(GLFWwindow* window, double x, double y) {
+    trace_begin("cursor");
     mouse_x = (float) x;
     mouse_y = (float) y;
 
@@ -47,15 +99,20 @@ void cursor_pos_callback(GLFWwindow* window, double x, double y) {
         float x_drag = mouse_x - drag_prev_x;
         float y_drag = mouse_y - drag_prev_y;
 
-        x_off -= x_drag * zoom;
-        y_off += y_drag * zoom;
+        camera_drag(&camera, x_drag, y_drag, (uint32_t) window_width, (uint32_t) window_height);
+        if (x_drag != 0.f || y_drag != 0.f) {
+            view_dirty = true;
+        }
 
         drag_prev_x = mouse_x;
         drag_prev_y = mouse_y;
     }
+    input_event_handled(&(input_event_t) { .type = INPUT_EVENT_CURSOR_POS, .x = x, .y = y });
+    trace_end();
 }
 
 void mouse_button_callback(GLFWwindow* window, int button, int action, int mods) {
+    trace_begin("mouse button");
     // TODO
     if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS) {
         is_dragging = true;
@@ -67,4 +124,6 @@ void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
         drag_prev_x = -1.f;
         drag_prev_y = -1.f;
     }
+    input_event_handled(&(input_event_t) { .type = INPUT_EVENT_MOUSE_BUTTON, .button = button, .action = action, .mods = mods });
+    trace_end();
 }
@@ -0,0 +1,122 @@
+#include <stdbool.h>
+#include <inttypes.h>
+#include <math.h>
+
+#include <bignum.h>
+#include <camera.h>
+#include <mandelbrot.h>
+
+// enough for both halves of a double-double around |c| < 2^31
+#define CENTER_PARSE_BITS 128
+
+// knuth's two-sum and its |a| >= |b| shortcut, as in main.frag's
+// PRECISION_DOUBLE_FLOAT. plain C doubles round every operation, so these
+// stay exact as long as nothing builds with -ffast-math
+static void two_sum(double a, double b, double* out_s, double* out_e) {
+    double s = a + b;
+    double v = s - a;
+    *out_s = s;
+    *out_e = (a - (s - v)) + (b - v);
+}
+
+static void quick_two_sum(double a, double b, double* out_s, double* out_e) {
+    double s = a + b;
+    *out_s = s;
+    *out_e = b - (s - a);
+}
+
+// (hi, lo) += d
+static void dd_add_double(double* hi, double* lo, double d) {
+    double s, e;
+    two_sum(*hi, d, &s, &e);
+    quick_two_sum(s, e + *lo, hi, lo);
+}
+
+void camera_init(camera_t* camera, double re, double im, double zoom) {
+    camera->re_hi = re;
+    camera->re_lo = 0.;
+    camera->im_hi = im;
+    camera->im_lo = 0.;
+    camera->zoom_log2 = log2(zoom);
+}
+
+// hi = a rounded, lo = what's left of a after that
+static void split_bignum(bignum_t* a, bignum_t* tmp, double* out_hi, double* out_lo) {
+    *out_hi = bignum_to_double(a);
+    bignum_set_double(tmp, *out_hi);
+    bignum_sub(a, a, tmp);
+    *out_lo = bignum_to_double(a);
+}
+
+bool camera_set_center_decimal(camera_t* camera, const char* re, const char* im) {
+    uint32_t num_limbs = bignum_limbs_for_bits(CENTER_PARSE_BITS);
+    bignum_t* c_re = bignum_create(num_limbs);
+    bignum_t* c_im = bignum_create(num_limbs);
+    bignum_t* tmp = bignum_create(num_limbs);
+
+    bool ok = bignum_set_decimal(c_re, re) && bignum_set_decimal(c_im, im);
+    if (ok) {
+        split_bignum(c_re, tmp, &camera->re_hi, &camera->re_lo);
+        split_bignum(c_im, tmp, &camera->im_hi, &camera->im_lo);
+    }
+
+    bignum_destroy(tmp);
+    bignum_destroy(c_im);
+    bignum_destroy(c_re);
+    return ok;
+}
+
+double camera_zoom(const camera_t* camera) {
+    return exp2(camera->zoom_log2);
+}
+
+void camera_zoom_by(camera_t* camera, double log2_factor) {
+    camera->zoom_log2 += log2_factor;
+}
+
+void camera_pan(camera_t* camera, double d_re, double d_im) {
+    dd_add_double(&camera->re_hi, &camera->re_lo, d_re);
+    dd_add_double(&camera->im_hi, &camera->im_lo, d_im);
+}
+
+void camera_drag(camera_t* camera, double dx, double dy, uint32_t width, uint32_t height) {
+    view_t view = camera_view(camera, width, height, 0);
+    double pixel_size = view_pixel_size(&view);
+    // the complex plane's y axis points up
+    camera_pan(camera, -dx * pixel_size, dy * pixel_size);
+}
+
+view_t camera_view(const camera_t* camera, uint32_t width, uint32_t height, uint32_t max_iter) {
+    return (view_t) {
+        .width = width,
+        .height = height,
+        .zoom = camera_zoom(camera),
+        .pan_x = camera->re_hi,
+        .pan_y = camera->im_hi,
+        .pan_x_lo = camera->re_lo,
+        .pan_y_lo = camera->im_lo,
+        .max_iter = max_iter,
+    };
+}
+
+view_t camera_view_rect(const camera_t* camera, uint32_t width, uint32_t height, const pixel_rect_t* rect, uint32_t max_iter) {
+    view_t full = camera_view(camera, width, height, max_iter);
+    double pixel_size = view_pixel_size(&full);
+    uint32_t rect_width = rect->x1 - rect->x0;
+    uint32_t rect_height = rect->y1 - rect->y0;
+
+    // either view's pan point is zoom in from its left and bottom edges
+    camera_t sub = *camera;
+    double zoom = .5 * pixel_size * ((rect_width < rect_height) ? rect_width : rect_height);
+    camera_pan(&sub, (double) rect->x0 * pixel_size - full.zoom + zoom, (double) (height - rect->y1) * pixel_size - full.zoom + zoom);
+
+    view_t view = camera_view(&sub, rect_width, rect_height, view_max_iter(&full));
+    view.zoom = zoom;
+    return view;
+}
+
+void camera_from_view(camera_t* camera, const view_t* view) {
+    quick_two_sum(view->pan_x, view->pan_x_lo, &camera->re_hi, &camera->re_lo);
+    quick_two_sum(view->pan_y, view->pan_y_lo, &camera->im_hi, &camera->im_lo);
+    camera->zoom_log2 = log2(view->zoom);
+}
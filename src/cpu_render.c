@@ -0,0 +1,643 @@
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <math.h>
+
+#include <bla.h>
+#include <cpu_render.h>
+#include <kernels.h>
+#include <mandelbrot.h>
+#include <perturbation.h>
+#include <thread_pool.h>
+#include <tile_scheduler.h>
+#include <trace.h>
+
+// pixel indices, y * width + x
+typedef struct {
+    uint32_t* pixels;
+    uint32_t count, capacity;
+} pixel_list_t;
+
+struct cpu_renderer {
+    thread_pool_t* pool;
+    tile_scheduler_t* sched;
+    schedule_t schedule;
+    uint32_t tile_size;
+    isa_t isa;
+    subdivide_t subdivide;
+    bool bulb_check;
+    double period_tolerance;    // in pixels, 0 = no cycle detection
+
+    // glitched pixels found by each worker, and all of them between passes
+    pixel_list_t* glitches;
+    pixel_list_t pending;
+    uint32_t max_references;
+    glitch_stats_t glitch_stats;
+};
+
+// everything a worker needs for one frame
+typedef struct {
+    const view_t* view;
+    iter_buffer_t* iters;
+    escape_row_fn kernel;
+    escape_column_fn column_kernel;
+    const reference_orbit_t* ref;   // set for perturbed frames, kernel is unused
+    const bla_table_t* bla;         // optional, on top of ref
+    double ref_off_x, ref_off_y;    // pan point - reference point
+    uint32_t max_iter;
+    pixel_rect_t rect;              // the part of iters being rendered
+    subdivide_t subdivide;          // within each tile
+    bool bulb_check;                // skip the main cardioid and period-2 bulb
+    double period_eps;              // kernels' cycle detection, 0 = off
+    uint32_t tile_size;
+    uint32_t tiles_x, tiles_y;
+    tile_scheduler_t* sched;
+
+    pixel_list_t* glitches;         // per worker, perturbed frames only
+    const pixel_list_t* redo;       // set for glitch passes: the pixels to redo
+} render_job_t;
+
+static void pixel_list_push(pixel_list_t* list, uint32_t pixel) {
+    if (list->count == list->capacity) {
+        list->capacity = list->capacity ? 2 * list->capacity : 256;
+        list->pixels = realloc(list->pixels, (size_t) list->capacity * sizeof(uint32_t));
+    }
+    list->pixels[list->count++] = pixel;
+}
+
+framebuffer_t* framebuffer_create(uint32_t width, uint32_t height) {
+    framebuffer_t* fb = malloc(sizeof(*fb));
+    fb->width = width;
+    fb->height = height;
+    fb->pixels = malloc((size_t) width * height * 3);
+    return fb;
+}
+
+void framebuffer_destroy(framebuffer_t* fb) {
+    free(fb->pixels);
+    free(fb);
+}
+
+iter_buffer_t* iter_buffer_create(uint32_t width, uint32_t height) {
+    iter_buffer_t* iters = malloc(sizeof(*iters));
+    iters->width = width;
+    iters->height = height;
+    iters->max_iter = 0;
+    iters->iter = malloc((size_t) width * height * sizeof(uint32_t));
+    return iters;
+}
+
+void iter_buffer_destroy(iter_buffer_t* iters) {
+    free(iters->iter);
+    free(iters);
+}
+
+void iter_buffer_shift(iter_buffer_t* iters, int32_t dx, int32_t dy) {
+    uint32_t adx = (uint32_t) abs(dx);
+    uint32_t ady = (uint32_t) abs(dy);
+    if (adx >= iters->width || ady >= iters->height) {
+        return;
+    }
+
+    // rows overlap when moving up or down, so go against the shift
+    uint32_t count = iters->width - adx;
+    uint32_t src_x = (dx > 0) ? 0 : adx;
+    uint32_t dst_x = (dx > 0) ? adx : 0;
+    uint32_t num_rows = iters->height - ady;
+    for (uint32_t k = 0; k < num_rows; k++) {
+        uint32_t dst_y = (dy > 0) ? iters->height - 1 - k : k;
+        uint32_t src_y = (uint32_t) ((int32_t) dst_y - dy);
+        memmove(
+            &iters->iter[(size_t) dst_y * iters->width + dst_x],
+            &iters->iter[(size_t) src_y * iters->width + src_x],
+            (size_t) count * sizeof(uint32_t)
+        );
+    }
+}
+
+cpu_renderer_t* cpu_renderer_create(uint32_t num_threads, uint32_t tile_size, isa_t isa) {
+    cpu_renderer_t* renderer = malloc(sizeof(*renderer));
+    renderer->pool = thread_pool_create(num_threads);
+    renderer->sched = tile_scheduler_create(thread_pool_size(renderer->pool));
+    renderer->schedule = SCHEDULE_STEAL;
+    renderer->tile_size = tile_size ? tile_size : CPU_DEFAULT_TILE_SIZE;
+    renderer->isa = isa_resolve(isa);
+    renderer->subdivide = SUBDIVIDE_OFF;
+    renderer->bulb_check = true;
+    renderer->period_tolerance = PERIOD_DEFAULT_TOLERANCE;
+    renderer->glitches = calloc(thread_pool_size(renderer->pool), sizeof(pixel_list_t));
+    renderer->pending = (pixel_list_t) { 0 };
+    renderer->max_references = CPU_DEFAULT_MAX_REFERENCES;
+    renderer->glitch_stats = (glitch_stats_t) { 0 };
+    return renderer;
+}
+
+void cpu_renderer_destroy(cpu_renderer_t* renderer) {
+    for (uint32_t w = 0; w < thread_pool_size(renderer->pool); w++) {
+        free(renderer->glitches[w].pixels);
+    }
+    free(renderer->glitches);
+    free(renderer->pending.pixels);
+
+    tile_scheduler_destroy(renderer->sched);
+    thread_pool_destroy(renderer->pool);
+    free(renderer);
+}
+
+uint32_t cpu_renderer_num_threads(const cpu_renderer_t* renderer) {
+    return thread_pool_size(renderer->pool);
+}
+
+isa_t cpu_renderer_set_isa(cpu_renderer_t* renderer, isa_t isa) {
+    renderer->isa = isa_resolve(isa);
+    return renderer->isa;
+}
+
+void cpu_renderer_set_schedule(cpu_renderer_t* renderer, schedule_t schedule) {
+    renderer->schedule = schedule;
+}
+
+const tile_scheduler_t* cpu_renderer_scheduler(const cpu_renderer_t* renderer) {
+    return renderer->sched;
+}
+
+void cpu_renderer_set_subdivide(cpu_renderer_t* renderer, subdivide_t subdivide) {
+    renderer->subdivide = subdivide;
+}
+
+void cpu_renderer_set_bulb_check(cpu_renderer_t* renderer, bool bulb_check) {
+    renderer->bulb_check = bulb_check;
+}
+
+void cpu_renderer_set_period_tolerance(cpu_renderer_t* renderer, double tolerance) {
+    renderer->period_tolerance = tolerance;
+}
+
+void cpu_renderer_set_max_references(cpu_renderer_t* renderer, uint32_t max_references) {
+    renderer->max_references = max_references;
+}
+
+const glitch_stats_t* cpu_renderer_glitch_stats(const cpu_renderer_t* renderer) {
+    return &renderer->glitch_stats;
+}
+
+isa_t cpu_renderer_frame_isa(const cpu_renderer_t* renderer, const view_t* view) {
+    if (renderer->isa != ISA_SCALAR && !kernel_float_precision_ok(view)) {
+        return ISA_SCALAR;
+    }
+    return renderer->isa;
+}
+
+// end of the run of points from k on, along (cx0 + j * step_x, cy0 + j *
+// step_y), that are all inside the main cardioid or period-2 bulb or all
+// outside them; *inside says which
+static uint32_t bulb_run(double cx0, double step_x, double cy0, double step_y, uint32_t k, uint32_t count, bool* inside) {
+    *inside = mandelbrot_in_main_bulbs(cx0 + k * step_x, cy0 + k * step_y);
+    uint32_t end = k + 1;
+    while (end < count && mandelbrot_in_main_bulbs(cx0 + end * step_x, cy0 + end * step_y) == *inside) {
+        end++;
+    }
+    return end;
+}
+
+static void fill_interior(uint32_t* iter, uint32_t count, uint32_t max_iter) {
+    for (uint32_t k = 0; k < count; k++) {
+        iter[k] = max_iter;
+    }
+}
+
+// iterates pixels (x, y) to (x + count - 1, y) into job->iters; returns
+// whether any of them glitched
+static bool render_span(const render_job_t* job, uint32_t worker, uint32_t x, uint32_t y, uint32_t count) {
+    uint32_t* iter = &job->iters->iter[(size_t) y * job->iters->width + x];
+    double dx = view_pixel_size(job->view);
+
+    if (!job->ref) {
+        double cx0, cy;
+        view_pixel_to_complex(job->view, x, y, &cx0, &cy);
+        if (!job->bulb_check) {
+            job->kernel(cx0, dx, cy, count, job->max_iter, job->period_eps, iter);
+            return false;
+        }
+
+        for (uint32_t k = 0; k < count;) {
+            bool inside;
+            uint32_t end = bulb_run(cx0, dx, cy, 0., k, count, &inside);
+            if (inside) {
+                fill_interior(&iter[k], end - k, job->max_iter);
+            } else {
+                job->kernel(cx0 + k * dx, dx, cy, end - k, job->max_iter, job->period_eps, &iter[k]);
+            }
+            k = end;
+        }
+        return false;
+    }
+
+    double dcx0, dcy;
+    view_pixel_to_delta(job->view, x, y, &dcx0, &dcy);
+    dcx0 += job->ref_off_x;
+    dcy += job->ref_off_y;
+    // C + dc rounded to double can only misplace points within an ulp of
+    // the boundary, which run to max_iter anyway
+    double cx0 = job->ref->c_re_d + dcx0;
+    double cy = job->ref->c_im_d + dcy;
+
+    for (uint32_t k = 0; k < count;) {
+        bool inside = false;
+        uint32_t end = job->bulb_check ? bulb_run(cx0, dx, cy, 0., k, count, &inside) : count;
+        if (inside) {
+            fill_interior(&iter[k], end - k, job->max_iter);
+        } else if (job->bla) {
+            bla_row(job->bla, dcx0 + k * dx, dx, dcy, end - k, job->max_iter, &iter[k]);
+        } else {
+            perturb_row(job->ref, dcx0 + k * dx, dx, dcy, end - k, job->max_iter, &iter[k]);
+        }
+        k = end;
+    }
+
+    bool glitched = false;
+    for (uint32_t k = 0; k < count; k++) {
+        if (iter[k] == PERTURB_GLITCHED) {
+            // interior until a glitch pass gets to it
+            pixel_list_push(&job->glitches[worker], y * job->iters->width + x + k);
+            iter[k] = job->max_iter;
+            glitched = true;
+        }
+    }
+    return glitched;
+}
+
+// the same for pixels (x, y) to (x, y + count - 1)
+static bool render_column(const render_job_t* job, uint32_t worker, uint32_t x, uint32_t y, uint32_t count) {
+    if (job->ref) {
+        bool glitched = false;
+        for (uint32_t k = 0; k < count; k++) {
+            glitched |= render_span(job, worker, x, y + k, 1);
+        }
+        return glitched;
+    }
+
+    // the kernel packs its counts, so go through a buffer a chunk at a time
+    uint32_t column[64];
+    double dy = -view_pixel_size(job->view);
+    for (uint32_t k = 0; k < count; k += 64) {
+        uint32_t n = (count - k < 64) ? count - k : 64;
+        double cx, cy0;
+        view_pixel_to_complex(job->view, x, y + k, &cx, &cy0);
+
+        for (uint32_t j = 0; j < n;) {
+            bool inside = false;
+            uint32_t end = job->bulb_check ? bulb_run(cx, 0., cy0, dy, j, n, &inside) : n;
+            if (inside) {
+                fill_interior(&column[j], end - j, job->max_iter);
+            } else {
+                job->column_kernel(cx, cy0 + j * dy, dy, end - j, job->max_iter, job->period_eps, &column[j]);
+            }
+            j = end;
+        }
+
+        for (uint32_t j = 0; j < n; j++) {
+            job->iters->iter[(size_t) (y + k + j) * job->iters->width + x] = column[j];
+        }
+    }
+    return false;
+}
+
+// rects with a side this short or shorter are iterated outright
+#define SUBDIVIDE_MIN_SIZE 4
+
+// mariani-silver on the inclusive rect (x0, y0) - (x1, y1), whose border is
+// already iterated: a border of one count is filled in, any other is split
+// in two across its longer side. glitched says the border has a glitched
+// pixel, whose count says nothing about its neighbours, so the rect has to
+// be iterated outright
+static void subdivide_rect(const render_job_t* job, uint32_t worker, uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1, bool glitched) {
+    if (x1 - x0 < 2 || y1 - y0 < 2) {
+        return;     // no interior
+    }
+    uint32_t width = job->iters->width;
+    uint32_t* iter = job->iters->iter;
+
+    if (x1 - x0 <= SUBDIVIDE_MIN_SIZE || y1 - y0 <= SUBDIVIDE_MIN_SIZE || glitched) {
+        for (uint32_t y = y0 + 1; y < y1; y++) {
+            render_span(job, worker, x0 + 1, y, x1 - x0 - 1);
+        }
+        return;
+    }
+
+    uint32_t count = iter[(size_t) y0 * width + x0];
+    bool uniform = job->subdivide == SUBDIVIDE_ON;
+    for (uint32_t x = x0; x <= x1 && uniform; x++) {
+        uniform = iter[(size_t) y0 * width + x] == count && iter[(size_t) y1 * width + x] == count;
+    }
+    for (uint32_t y = y0; y <= y1 && uniform; y++) {
+        uniform = iter[(size_t) y * width + x0] == count && iter[(size_t) y * width + x1] == count;
+    }
+
+    if (uniform) {
+        for (uint32_t y = y0 + 1; y < y1; y++) {
+            uint32_t* row = &iter[(size_t) y * width];
+            for (uint32_t x = x0 + 1; x < x1; x++) {
+                row[x] = count;
+            }
+        }
+        return;
+    }
+
+    if (x1 - x0 >= y1 - y0) {
+        uint32_t mid = x0 + (x1 - x0) / 2;
+        glitched = render_column(job, worker, mid, y0 + 1, y1 - y0 - 1);
+        subdivide_rect(job, worker, x0, y0, mid, y1, glitched);
+        subdivide_rect(job, worker, mid, y0, x1, y1, glitched);
+    } else {
+        uint32_t mid = y0 + (y1 - y0) / 2;
+        glitched = render_span(job, worker, x0 + 1, mid, x1 - x0 - 1);
+        subdivide_rect(job, worker, x0, y0, x1, mid, glitched);
+        subdivide_rect(job, worker, x0, mid, x1, y1, glitched);
+    }
+}
+
+static void render_tile(void* ctx, uint32_t worker, uint32_t tile) {
+    const render_job_t* job = ctx;
+
+    uint32_t x0 = job->rect.x0 + (tile % job->tiles_x) * job->tile_size;
+    uint32_t y0 = job->rect.y0 + (tile / job->tiles_x) * job->tile_size;
+    uint32_t x1 = x0 + job->tile_size;
+    uint32_t y1 = y0 + job->tile_size;
+    if (x1 > job->rect.x1) { x1 = job->rect.x1; }
+    if (y1 > job->rect.y1) { y1 = job->rect.y1; }
+    trace_begin("tile");
+
+    if (job->subdivide == SUBDIVIDE_OFF) {
+        for (uint32_t y = y0; y < y1; y++) {
+            render_span(job, worker, x0, y, x1 - x0);
+        }
+        trace_end();
+        return;
+    }
+
+    // the tile's border, then whatever subdivide_rect() can't fill
+    bool glitched = render_span(job, worker, x0, y0, x1 - x0);
+    if (y1 - y0 > 1) {
+        glitched |= render_span(job, worker, x0, y1 - 1, x1 - x0);
+        glitched |= render_column(job, worker, x0, y0 + 1, y1 - y0 - 2);
+        if (x1 - x0 > 1) {
+            glitched |= render_column(job, worker, x1 - 1, y0 + 1, y1 - y0 - 2);
+        }
+    }
+    subdivide_rect(job, worker, x0, y0, x1 - 1, y1 - 1, glitched);
+    trace_end();
+}
+
+// worker w redoes its contiguous share of job->redo against job->ref
+static void redo_worker(void* ctx, uint32_t worker, uint32_t num_workers) {
+    const render_job_t* job = ctx;
+    uint32_t begin = (uint32_t) ((uint64_t) job->redo->count * worker / num_workers);
+    uint32_t end = (uint32_t) ((uint64_t) job->redo->count * (worker + 1) / num_workers);
+
+    for (uint32_t k = begin; k < end; k++) {
+        uint32_t pixel = job->redo->pixels[k];
+        uint32_t x = pixel % job->iters->width;
+        uint32_t y = pixel / job->iters->width;
+
+        double dcx, dcy;
+        view_pixel_to_delta(job->view, x, y, &dcx, &dcy);
+        dcx += job->ref_off_x;
+        dcy += job->ref_off_y;
+        uint32_t i = job->bla
+            ? bla_iterate(job->bla, dcx, dcy, job->max_iter)
+            : perturb_iterate(job->ref, dcx, dcy, job->max_iter);
+
+        if (i == PERTURB_GLITCHED) {
+            pixel_list_push(&job->glitches[worker], pixel);
+        } else {
+            job->iters->iter[pixel] = i;
+        }
+    }
+}
+
+// static split: worker w takes tiles w, w + n, w + 2n, ...
+static void render_worker_static(void* ctx, uint32_t worker, uint32_t num_workers) {
+    const render_job_t* job = ctx;
+    uint32_t num_tiles = job->tiles_x * job->tiles_y;
+
+    for (uint32_t tile = worker; tile < num_tiles; tile += num_workers) {
+        render_tile(ctx, worker, tile);
+    }
+}
+
+// the scheduler was created for the pool, so it already has num_workers deques
+static void render_worker_steal(void* ctx, uint32_t worker, uint32_t num_workers) {
+    (void) num_workers;
+    const render_job_t* job = ctx;
+    tile_scheduler_work(job->sched, worker, render_tile, ctx);
+}
+
+static void render(cpu_renderer_t* renderer, render_job_t* job) {
+    job->tile_size = renderer->tile_size;
+    job->tiles_x = (job->rect.x1 - job->rect.x0 + renderer->tile_size - 1) / renderer->tile_size;
+    job->tiles_y = (job->rect.y1 - job->rect.y0 + renderer->tile_size - 1) / renderer->tile_size;
+    job->iters->max_iter = job->max_iter;
+    job->sched = renderer->sched;
+    job->glitches = renderer->glitches;
+
+    trace_begin("render");
+    if (renderer->schedule == SCHEDULE_STEAL) {
+        tile_scheduler_reset(renderer->sched, job->tiles_x * job->tiles_y);
+        thread_pool_run(renderer->pool, render_worker_steal, job);
+    } else {
+        thread_pool_run(renderer->pool, render_worker_static, job);
+    }
+    trace_end();
+}
+
+// moves every worker's glitched pixels into renderer->pending
+static void gather_glitches(cpu_renderer_t* renderer) {
+    renderer->pending.count = 0;
+    for (uint32_t w = 0; w < thread_pool_size(renderer->pool); w++) {
+        pixel_list_t* list = &renderer->glitches[w];
+        for (uint32_t k = 0; k < list->count; k++) {
+            pixel_list_push(&renderer->pending, list->pixels[k]);
+        }
+        list->count = 0;
+    }
+}
+
+// the pending pixel nearest the middle of all of them, which lands inside
+// the glitch when there is only one blob and at least inside some blob when
+// there are several
+static uint32_t pick_reference_pixel(const pixel_list_t* pending, uint32_t width) {
+    double sum_x = 0., sum_y = 0.;
+    for (uint32_t k = 0; k < pending->count; k++) {
+        sum_x += pending->pixels[k] % width;
+        sum_y += pending->pixels[k] / width;
+    }
+    double mid_x = sum_x / pending->count;
+    double mid_y = sum_y / pending->count;
+
+    uint32_t best = pending->pixels[0];
+    double best_dist = INFINITY;
+    for (uint32_t k = 0; k < pending->count; k++) {
+        double dist = hypot(pending->pixels[k] % width - mid_x, pending->pixels[k] / width - mid_y);
+        if (dist < best_dist) {
+            best = pending->pixels[k];
+            best_dist = dist;
+        }
+    }
+    return best;
+}
+
+// redoes the glitched pixels of job, one secondary reference per pass, until
+// none are left or max_references are used up
+static void correct_glitches(cpu_renderer_t* renderer, const render_job_t* job) {
+    gather_glitches(renderer);
+    renderer->glitch_stats.glitched = renderer->pending.count;
+
+    uint32_t width = job->iters->width;
+    while (renderer->pending.count > 0 && renderer->glitch_stats.references < renderer->max_references) {
+        // secondaries are placed relative to the primary, whose C is exact
+        uint32_t pick = pick_reference_pixel(&renderer->pending, width);
+        double ref_dx, ref_dy;
+        view_pixel_to_delta(job->view, pick % width, pick / width, &ref_dx, &ref_dy);
+        ref_dx += job->ref_off_x;
+        ref_dy += job->ref_off_y;
+
+        reference_orbit_t* secondary = reference_orbit_offset(job->ref, ref_dx, ref_dy, job->max_iter);
+        bla_table_t* secondary_bla = NULL;
+
+        render_job_t redo = *job;
+        redo.ref = secondary;
+        redo.ref_off_x = job->ref_off_x - ref_dx;
+        redo.ref_off_y = job->ref_off_y - ref_dy;
+        redo.redo = &renderer->pending;
+
+        if (job->bla) {
+            // only has to hold for the pixels being redone
+            double dc_max = 0.;
+            for (uint32_t k = 0; k < renderer->pending.count; k++) {
+                uint32_t pixel = renderer->pending.pixels[k];
+                double dcx, dcy;
+                view_pixel_to_delta(job->view, pixel % width, pixel / width, &dcx, &dcy);
+                dc_max = fmax(dc_max, hypot(dcx + redo.ref_off_x, dcy + redo.ref_off_y));
+            }
+            secondary_bla = bla_table_build(secondary, dc_max, job->bla->epsilon);
+        }
+        redo.bla = secondary_bla;
+
+        thread_pool_run(renderer->pool, redo_worker, &redo);
+        renderer->glitch_stats.references++;
+
+        if (secondary_bla) {
+            bla_table_destroy(secondary_bla);
+        }
+        reference_orbit_destroy(secondary);
+
+        // the picked pixel is exact against its own orbit, so this shrinks
+        gather_glitches(renderer);
+    }
+
+    renderer->glitch_stats.unresolved = renderer->pending.count;
+}
+
+void cpu_renderer_render_rect(cpu_renderer_t* renderer, const view_t* view, const perturb_frame_t* perturb, const pixel_rect_t* rect, iter_buffer_t* iters) {
+    render_job_t job = {
+        .view = view,
+        .iters = iters,
+        .max_iter = view_max_iter(view),
+        .rect = *rect,
+        .subdivide = renderer->subdivide,
+        .bulb_check = renderer->bulb_check,
+        .period_eps = renderer->period_tolerance * view_pixel_size(view),
+    };
+    // the stats only ever cover this call, empty or not
+    renderer->glitch_stats = (glitch_stats_t) { 0 };
+    if (rect->x0 >= rect->x1 || rect->y0 >= rect->y1) {
+        return;
+    }
+
+    if (!perturb) {
+        job.kernel = kernel_for_isa(cpu_renderer_frame_isa(renderer, view));
+        job.column_kernel = column_kernel_for_isa(cpu_renderer_frame_isa(renderer, view));
+        render(renderer, &job);
+        return;
+    }
+
+    job.ref = perturb->ref;
+    job.bla = perturb->bla;
+    job.ref_off_x = perturb->ref_off_x;
+    job.ref_off_y = perturb->ref_off_y;
+    render(renderer, &job);
+    trace_begin("correct glitches");
+    correct_glitches(renderer, &job);
+    trace_end();
+}
+
+void cpu_renderer_render(cpu_renderer_t* renderer, const view_t* view, iter_buffer_t* iters) {
+    pixel_rect_t rect = { 0, 0, iters->width, iters->height };
+    cpu_renderer_render_rect(renderer, view, NULL, &rect, iters);
+}
+
+void cpu_renderer_render_perturbed(cpu_renderer_t* renderer, const view_t* view, const reference_orbit_t* ref, const bla_table_t* bla, double ref_off_x, double ref_off_y, iter_buffer_t* iters) {
+    perturb_frame_t perturb = {
+        .ref = ref,
+        .bla = bla,
+        .ref_off_x = ref_off_x,
+        .ref_off_y = ref_off_y,
+    };
+    pixel_rect_t rect = { 0, 0, iters->width, iters->height };
+    cpu_renderer_render_rect(renderer, view, &perturb, &rect, iters);
+}
+
+typedef struct {
+    const iter_buffer_t* iters;
+    const palette_t* palette;
+    const uint8_t* lut;         // rgb for every count up to max_iter, or NULL
+    framebuffer_t* fb;
+} colorize_job_t;
+
+// worker w colors its contiguous band of rows
+static void colorize_worker(void* ctx, uint32_t worker, uint32_t num_workers) {
+    const colorize_job_t* job = ctx;
+    uint32_t max_iter = job->iters->max_iter;
+    uint32_t y0 = (uint32_t) ((uint64_t) job->fb->height * worker / num_workers);
+    uint32_t y1 = (uint32_t) ((uint64_t) job->fb->height * (worker + 1) / num_workers);
+    size_t begin = (size_t) y0 * job->fb->width;
+    size_t end = (size_t) y1 * job->fb->width;
+
+    for (size_t k = begin; k < end; k++) {
+        uint32_t iter = job->iters->iter[k];
+        uint8_t* rgb = &job->fb->pixels[k * 3];
+        if (job->lut) {
+            const uint8_t* color = &job->lut[(size_t) ((iter < max_iter) ? iter : max_iter) * 3];
+            rgb[0] = color[0];
+            rgb[1] = color[1];
+            rgb[2] = color[2];
+        } else {
+            palette_colorize(job->palette, iter, max_iter, rgb);
+        }
+    }
+}
+
+void cpu_renderer_colorize(cpu_renderer_t* renderer, const iter_buffer_t* iters, const palette_t* palette, framebuffer_t* fb) {
+    colorize_job_t job = {
+        .iters = iters,
+        .palette = palette,
+        .lut = NULL,
+        .fb = fb,
+    };
+
+    // with fewer distinct counts than pixels, color each count once
+    uint8_t* lut = NULL;
+    if (iters->max_iter < (uint64_t) iters->width * iters->height) {
+        lut = malloc(((size_t) iters->max_iter + 1) * 3);
+        for (uint32_t i = 0; i <= iters->max_iter; i++) {
+            palette_colorize(palette, i, iters->max_iter, &lut[(size_t) i * 3]);
+        }
+        job.lut = lut;
+    }
+
+    trace_begin("colorize");
+    thread_pool_run(renderer->pool, colorize_worker, &job);
+    trace_end();
+    free(lut);
+}
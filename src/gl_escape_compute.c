@@ -0,0 +1,72 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#include <inttypes.h>
+
+#include <glad/glad.h>
+
+#include <gl_escape_compute.h>
+
+// binding points in shader/escape.comp
+#define TILES_IN_BINDING 3
+#define TILES_OUT_BINDING 4
+
+// each split quarters a tile, and the biggest queue is the one after the
+// last split
+#define QUEUE_CAPACITY (ESCAPE_CHUNK_TILES_X * ESCAPE_CHUNK_TILES_Y * (ESCAPE_TILE_SIZE / ESCAPE_MIN_TILE) * (ESCAPE_TILE_SIZE / ESCAPE_MIN_TILE))
+
+// header: (count, 1, 1, unused), a DispatchIndirectCommand padded to a uvec4
+static const uint32_t EMPTY_HEADER[4] = { 0, 1, 1, 0 };
+
+void gl_escape_compute_init(gl_escape_compute_t* ec) {
+    glGenBuffers(2, ec->queues);
+    for (uint32_t i = 0; i < 2; i++) {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, ec->queues[i]);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, (GLsizeiptr) (1 + QUEUE_CAPACITY) * 4 * sizeof(uint32_t), NULL, GL_DYNAMIC_COPY);
+    }
+}
+
+void gl_escape_compute_destroy(gl_escape_compute_t* ec) {
+    glDeleteBuffers(2, ec->queues);
+}
+
+// every pass of one chunk
+static void run_chunk(gl_escape_compute_t* ec, int32_t rect_loc, int32_t first_pass_loc, uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1) {
+    glUniform4ui(rect_loc, x0, y0, x1, y1);
+
+    uint32_t out = 0;
+    for (uint32_t size = ESCAPE_TILE_SIZE; size >= ESCAPE_MIN_TILE; size /= 2) {
+        uint32_t in = out ^ 1;
+        bool first = size == ESCAPE_TILE_SIZE;
+        // the last pass splits nothing
+        if (size > ESCAPE_MIN_TILE) {
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, ec->queues[out]);
+            glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(EMPTY_HEADER), EMPTY_HEADER);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, TILES_OUT_BINDING, ec->queues[out]);
+        }
+
+        glUniform1i(first_pass_loc, first);
+        if (first) {
+            glDispatchCompute((x1 - x0 + ESCAPE_TILE_SIZE - 1) / ESCAPE_TILE_SIZE, (y1 - y0 + ESCAPE_TILE_SIZE - 1) / ESCAPE_TILE_SIZE, 1);
+        } else {
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, TILES_IN_BINDING, ec->queues[in]);
+            glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, ec->queues[in]);
+            glDispatchComputeIndirect(0);
+        }
+        // the queue just written is read, and dispatched from, next
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+        out ^= 1;
+    }
+}
+
+void gl_escape_compute_run(gl_escape_compute_t* ec, int32_t rect_loc, int32_t first_pass_loc, uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1) {
+    const uint32_t chunk_width = ESCAPE_CHUNK_TILES_X * ESCAPE_TILE_SIZE;
+    const uint32_t chunk_height = ESCAPE_CHUNK_TILES_Y * ESCAPE_TILE_SIZE;
+    for (uint32_t y = y0; y < y1; y += chunk_height) {
+        for (uint32_t x = x0; x < x1; x += chunk_width) {
+            uint32_t cx1 = (x1 - x > chunk_width) ? x + chunk_width : x1;
+            uint32_t cy1 = (y1 - y > chunk_height) ? y + chunk_height : y1;
+            run_chunk(ec, rect_loc, first_pass_loc, x, y, cx1, cy1);
+        }
+    }
+    glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, 0);
+}
@@ -0,0 +1,71 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#include <inttypes.h>
+
+#include <glad/glad.h>
+
+#include <gl_iter_buffer.h>
+
+static void allocate_textures(gl_iter_buffer_t* buffer, uint32_t width, uint32_t height) {
+    for (uint32_t i = 0; i < 2; i++) {
+        glBindTexture(GL_TEXTURE_2D, buffer->texture[i]);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32F, (GLsizei) width, (GLsizei) height, 0, GL_RG, GL_FLOAT, NULL);
+    }
+    buffer->width = width;
+    buffer->height = height;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, buffer->fbo);
+    glFramebufferParameteri(GL_FRAMEBUFFER, GL_FRAMEBUFFER_DEFAULT_WIDTH, (GLint) width);
+    glFramebufferParameteri(GL_FRAMEBUFFER, GL_FRAMEBUFFER_DEFAULT_HEIGHT, (GLint) height);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void gl_iter_buffer_init(gl_iter_buffer_t* buffer, uint32_t width, uint32_t height) {
+    glGenTextures(2, buffer->texture);
+    for (uint32_t i = 0; i < 2; i++) {
+        glBindTexture(GL_TEXTURE_2D, buffer->texture[i]);
+        // read with texelFetch, but a complete texture still needs these
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+    glGenFramebuffers(1, &buffer->fbo);
+    allocate_textures(buffer, width, height);
+    buffer->current = 0;
+}
+
+void gl_iter_buffer_destroy(gl_iter_buffer_t* buffer) {
+    glDeleteFramebuffers(1, &buffer->fbo);
+    glDeleteTextures(2, buffer->texture);
+}
+
+void gl_iter_buffer_bind(const gl_iter_buffer_t* buffer) {
+    glBindImageTexture(0, buffer->texture[buffer->current], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RG32F);
+    glBindFramebuffer(GL_FRAMEBUFFER, buffer->fbo);
+}
+
+bool gl_iter_buffer_resize(gl_iter_buffer_t* buffer, uint32_t width, uint32_t height) {
+    if (buffer->width == width && buffer->height == height) {
+        return false;
+    }
+    allocate_textures(buffer, width, height);
+    return true;
+}
+
+void gl_iter_buffer_shift(gl_iter_buffer_t* buffer, int32_t dx, int32_t dy) {
+    uint32_t next = buffer->current ^ 1;
+
+    // texture rows go bottom up, so the shift's y flips
+    int32_t gl_dy = -dy;
+    int32_t copy_width = (int32_t) buffer->width - abs(dx);
+    int32_t copy_height = (int32_t) buffer->height - abs(gl_dy);
+    if (copy_width > 0 && copy_height > 0) {
+        glCopyImageSubData(
+            buffer->texture[buffer->current], GL_TEXTURE_2D, 0, (dx < 0) ? -dx : 0, (gl_dy < 0) ? -gl_dy : 0, 0,
+            buffer->texture[next], GL_TEXTURE_2D, 0, (dx > 0) ? dx : 0, (gl_dy > 0) ? gl_dy : 0, 0,
+            copy_width, copy_height, 1
+        );
+    }
+    buffer->current = next;
+}
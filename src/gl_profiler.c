@@ -0,0 +1,254 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <gl_profiler.h>
+#include <trace.h>
+
+// overlay layout, same as shader/profiler.frag
+#define HALF_HEIGHT 80
+#define GAP 8
+#define BUCKET_WIDTH 2
+#define MARGIN 8
+#define PANEL_WIDTH (PROFILER_HISTORY + GAP + PROFILER_BUCKETS * BUCKET_WIDTH)
+#define PANEL_HEIGHT (2 * HALF_HEIGHT)
+// u_data's rows: CPU times, GPU times, histogram
+#define DATA_ROWS (2 * PROFILER_STAGE_COUNT + 1)
+
+static const char* STAGE_NAMES[PROFILER_STAGE_COUNT] = {
+    [PROFILER_STAGE_PREPARE] = "prepare",
+    [PROFILER_STAGE_UNIFORMS] = "uniforms",
+    [PROFILER_STAGE_ESCAPE] = "escape",
+    [PROFILER_STAGE_COLORIZE] = "colorize",
+    [PROFILER_STAGE_OVERLAY] = "overlay",
+    [PROFILER_STAGE_SWAP] = "swap",
+};
+
+static const float STAGE_COLORS[PROFILER_STAGE_COUNT][3] = {
+    [PROFILER_STAGE_PREPARE] = { .55f, .35f, .85f },   // purple
+    [PROFILER_STAGE_UNIFORMS] = { .95f, .75f, .2f },   // yellow
+    [PROFILER_STAGE_ESCAPE] = { .9f, .3f, .25f },      // red
+    [PROFILER_STAGE_COLORIZE] = { .3f, .7f, .95f },    // blue
+    [PROFILER_STAGE_OVERLAY] = { .6f, .6f, .6f },      // gray
+    [PROFILER_STAGE_SWAP] = { .35f, .85f, .4f },       // green
+};
+
+// swap only blocks the CPU; a timestamp after it lands in the next frame
+static bool stage_on_gpu(profiler_stage_t stage) {
+    return stage != PROFILER_STAGE_SWAP;
+}
+
+static void write_csv_header(FILE* f) {
+    fprintf(f, "frame");
+    for (uint32_t s = 0; s < PROFILER_STAGE_COUNT; s++) {
+        fprintf(f, ",%s_cpu_ms,%s_gpu_ms", STAGE_NAMES[s], STAGE_NAMES[s]);
+    }
+    fprintf(f, ",frame_cpu_ms\n");
+}
+
+// a stage that didn't run leaves both its fields empty, one the GPU didn't
+// measure its gpu field
+static void write_csv_row(FILE* f, const profiler_frame_t* frame) {
+    fprintf(f, "%" PRIu64, frame->frame);
+    for (uint32_t s = 0; s < PROFILER_STAGE_COUNT; s++) {
+        if (!(frame->ran & (1u << s))) {
+            fprintf(f, ",,");
+        } else if (frame->gpu_ms[s] < 0.) {
+            fprintf(f, ",%.4f,", frame->cpu_ms[s]);
+        } else {
+            fprintf(f, ",%.4f,%.4f", frame->cpu_ms[s], frame->gpu_ms[s]);
+        }
+    }
+    fprintf(f, ",%.4f\n", frame->frame_ms);
+}
+
+// a frame with all its times in
+static void finish_frame(gl_profiler_t* profiler, const profiler_frame_t* frame) {
+    profiler->history[profiler->history_next] = *frame;
+    profiler->history_next = (profiler->history_next + 1) % PROFILER_HISTORY;
+    if (profiler->history_count < PROFILER_HISTORY) {
+        profiler->history_count++;
+    }
+    if (profiler->csv) {
+        write_csv_row(profiler->csv, frame);
+    }
+}
+
+// the GPU times of set's frame if they're all in; with give_up, whatever
+// isn't in is dropped instead
+static bool collect_set(gl_profiler_t* profiler, uint32_t set, bool give_up) {
+    profiler_frame_t* frame = &profiler->pending[set];
+    for (uint32_t s = 0; s < PROFILER_STAGE_COUNT; s++) {
+        if (!(frame->ran & (1u << s)) || !stage_on_gpu(s)) {
+            continue;
+        }
+        int32_t ready = 0;
+        glGetQueryObjectiv(profiler->queries[set][s][1], GL_QUERY_RESULT_AVAILABLE, &ready);
+        if (!ready) {
+            if (!give_up) {
+                return false;
+            }
+            continue;
+        }
+        uint64_t begin_ns = 0, end_ns = 0;
+        glGetQueryObjectui64v(profiler->queries[set][s][0], GL_QUERY_RESULT, &begin_ns);
+        glGetQueryObjectui64v(profiler->queries[set][s][1], GL_QUERY_RESULT, &end_ns);
+        frame->gpu_ms[s] = (double) (end_ns - begin_ns) * 1e-6;
+    }
+    finish_frame(profiler, frame);
+    profiler->set_pending[set] = false;
+    return true;
+}
+
+bool gl_profiler_init(gl_profiler_t* profiler, const char* csv_path, uint32_t program) {
+    memset(profiler, 0, sizeof(*profiler));
+    if (csv_path) {
+        profiler->csv = fopen(csv_path, "w");
+        if (!profiler->csv) {
+            return false;
+        }
+        write_csv_header(profiler->csv);
+    }
+    profiler->enabled = profiler->csv != NULL;
+
+    glGenQueries(PROFILER_QUERY_SETS * PROFILER_STAGE_COUNT * 2, &profiler->queries[0][0][0]);
+
+    profiler->program = program;
+    profiler->uni_loc_data = glGetUniformLocation(program, "u_data");
+    profiler->uni_loc_origin = glGetUniformLocation(program, "u_origin");
+    profiler->uni_loc_columns = glGetUniformLocation(program, "u_columns");
+    profiler->uni_loc_colors = glGetUniformLocation(program, "u_colors");
+
+    glGenTextures(1, &profiler->texture);
+    glBindTexture(GL_TEXTURE_2D, profiler->texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, PROFILER_HISTORY, DATA_ROWS, 0, GL_RED, GL_FLOAT, NULL);
+    return true;
+}
+
+void gl_profiler_destroy(gl_profiler_t* profiler) {
+    // whatever's still in flight is worth the wait now
+    glFinish();
+    for (uint32_t i = 0; i < PROFILER_QUERY_SETS; i++) {
+        uint32_t set = (profiler->frame_no + i) % PROFILER_QUERY_SETS;
+        if (profiler->set_pending[set]) {
+            collect_set(profiler, set, true);
+        }
+    }
+    if (profiler->csv) {
+        fclose(profiler->csv);
+    }
+    glDeleteQueries(PROFILER_QUERY_SETS * PROFILER_STAGE_COUNT * 2, &profiler->queries[0][0][0]);
+    glDeleteTextures(1, &profiler->texture);
+}
+
+void gl_profiler_show(gl_profiler_t* profiler, bool show) {
+    profiler->show = show;
+    profiler->enabled = show || profiler->csv != NULL;
+}
+
+void gl_profiler_frame_begin(gl_profiler_t* profiler) {
+    if (!profiler->enabled) {
+        return;
+    }
+    profiler->set = profiler->frame_no % PROFILER_QUERY_SETS;
+    // oldest first, which is this frame's own set: that one can't be waited
+    // for, and the rest stop at the first that isn't in, so history stays
+    // in frame order
+    for (uint32_t i = 0; i < PROFILER_QUERY_SETS; i++) {
+        uint32_t set = (profiler->set + i) % PROFILER_QUERY_SETS;
+        if (profiler->set_pending[set] && !collect_set(profiler, set, i == 0)) {
+            break;
+        }
+    }
+
+    profiler->current = (profiler_frame_t) { .frame = profiler->frame_no };
+    for (uint32_t s = 0; s < PROFILER_STAGE_COUNT; s++) {
+        profiler->current.gpu_ms[s] = -1.;
+    }
+    profiler->frame_start = glfwGetTime();
+}
+
+void gl_profiler_frame_end(gl_profiler_t* profiler) {
+    if (!profiler->enabled) {
+        return;
+    }
+    profiler->current.frame_ms = (glfwGetTime() - profiler->frame_start) * 1e3;
+    profiler->pending[profiler->set] = profiler->current;
+    profiler->set_pending[profiler->set] = true;
+    profiler->frame_no++;
+}
+
+void gl_profiler_begin(gl_profiler_t* profiler, profiler_stage_t stage) {
+    trace_begin(STAGE_NAMES[stage]);
+    if (!profiler->enabled) {
+        return;
+    }
+    if (stage_on_gpu(stage)) {
+        glQueryCounter(profiler->queries[profiler->set][stage][0], GL_TIMESTAMP);
+    }
+    profiler->stage_start[stage] = glfwGetTime();
+}
+
+void gl_profiler_end(gl_profiler_t* profiler, profiler_stage_t stage) {
+    trace_end();
+    if (!profiler->enabled) {
+        return;
+    }
+    profiler->current.cpu_ms[stage] = (glfwGetTime() - profiler->stage_start[stage]) * 1e3;
+    if (stage_on_gpu(stage)) {
+        glQueryCounter(profiler->queries[profiler->set][stage][1], GL_TIMESTAMP);
+    }
+    profiler->current.ran |= 1u << stage;
+}
+
+void gl_profiler_draw(gl_profiler_t* profiler, uint32_t window_width, uint32_t window_height) {
+    if (!profiler->show) {
+        return;
+    }
+
+    // oldest frame in the leftmost of the columns in use
+    static float data[DATA_ROWS][PROFILER_HISTORY];
+    memset(data, 0, sizeof(data));
+    uint32_t first_column = PROFILER_HISTORY - profiler->history_count;
+    uint32_t counts[PROFILER_BUCKETS] = { 0 };
+    uint32_t max_count = 1;
+    for (uint32_t i = 0; i < profiler->history_count; i++) {
+        const profiler_frame_t* frame = &profiler->history[(profiler->history_next + PROFILER_HISTORY - profiler->history_count + i) % PROFILER_HISTORY];
+        for (uint32_t s = 0; s < PROFILER_STAGE_COUNT; s++) {
+            data[s][first_column + i] = (float) frame->cpu_ms[s];
+            data[PROFILER_STAGE_COUNT + s][first_column + i] = (float) frame->gpu_ms[s];
+        }
+        uint32_t bucket = (frame->frame_ms < PROFILER_BUCKETS - 1) ? (uint32_t) frame->frame_ms : PROFILER_BUCKETS - 1;
+        if (++counts[bucket] > max_count) {
+            max_count = counts[bucket];
+        }
+    }
+    for (uint32_t b = 0; b < PROFILER_BUCKETS; b++) {
+        data[2 * PROFILER_STAGE_COUNT][b] = (float) counts[b] / (float) max_count;
+    }
+
+    glUseProgram(profiler->program);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, profiler->texture);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, PROFILER_HISTORY, DATA_ROWS, GL_RED, GL_FLOAT, data);
+    glUniform1i(profiler->uni_loc_data, 0);
+    glUniform2f(profiler->uni_loc_origin, MARGIN, MARGIN);
+    glUniform1i(profiler->uni_loc_columns, (int32_t) profiler->history_count);
+    glUniform3fv(profiler->uni_loc_colors, PROFILER_STAGE_COUNT, &STAGE_COLORS[0][0]);
+
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glViewport(MARGIN, MARGIN, PANEL_WIDTH, PANEL_HEIGHT);
+    glDrawElements(GL_TRIANGLE_STRIP, 4, GL_UNSIGNED_BYTE, 0);
+    glViewport(0, 0, (GLsizei) window_width, (GLsizei) window_height);
+    glDisable(GL_BLEND);
+}
@@ -0,0 +1,353 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <inttypes.h>
+#include <math.h>
+#include <pthread.h>
+
+#include <glad/glad.h>
+
+#include <bignum.h>
+#include <bla.h>
+#include <gl_reference.h>
+#include <mandelbrot.h>
+#include <perturbation.h>
+#include <reference_cache.h>
+#include <trace.h>
+
+void gl_reference_init(gl_reference_t* glref, reference_cache_t* cache) {
+    glGenBuffers(1, &glref->ssbo);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, glref->ssbo);
+    glref->ref = NULL;
+    glref->cache = cache;
+
+    glref->computing = false;
+    glref->pending = NULL;
+
+    glGenBuffers(1, &glref->bla_ssbo);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, glref->bla_ssbo);
+    glref->bla = NULL;
+
+    uint32_t zero = 0;
+    glGenBuffers(1, &glref->glitch_ssbo);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, glref->glitch_ssbo);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(zero), &zero, GL_DYNAMIC_READ);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, glref->glitch_ssbo);
+}
+
+// an orbit the view is done with goes to the cache, or away without one
+static void retire(gl_reference_t* glref, reference_orbit_t* ref, bla_table_t* bla) {
+    if (glref->cache && ref->length > 0) {
+        reference_cache_put(glref->cache, ref, bla);
+        return;
+    }
+    if (bla) {
+        bla_table_destroy(bla);
+    }
+    reference_orbit_destroy(ref);
+}
+
+static void retire_current(gl_reference_t* glref) {
+    if (glref->ref) {
+        retire(glref, glref->ref, glref->bla);
+    } else if (glref->bla) {
+        bla_table_destroy(glref->bla);
+    }
+    glref->ref = NULL;
+    glref->bla = NULL;
+}
+
+static void cancel_pending(gl_reference_t* glref);
+
+void gl_reference_destroy(gl_reference_t* glref) {
+    cancel_pending(glref);
+    retire_current(glref);
+    glDeleteBuffers(1, &glref->glitch_ssbo);
+    glDeleteBuffers(1, &glref->bla_ssbo);
+    glDeleteBuffers(1, &glref->ssbo);
+}
+
+void gl_reference_reset_glitched(gl_reference_t* glref) {
+    uint32_t zero = 0;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, glref->glitch_ssbo);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(zero), &zero);
+}
+
+uint32_t gl_reference_glitched(const gl_reference_t* glref) {
+    uint32_t glitched = 0;
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, glref->glitch_ssbo);
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(glitched), &glitched);
+    return glitched;
+}
+
+// half the longer side of the view in the complex plane
+static double view_extent(const view_t* view) {
+    return view->zoom * ((view->width > view->height) ? view->width : view->height)
+        / ((view->width < view->height) ? view->width : view->height);
+}
+
+// an orbit at c computed at ref_bits to ref_max_iter (and escaped there or
+// not) can serve view
+static bool reference_fits(double c_re, double c_im, uint32_t ref_bits, uint32_t ref_max_iter, bool escaped, const view_t* view, uint32_t precision_bits, uint32_t max_iter) {
+    if (ref_bits < precision_bits) {
+        return false;
+    }
+    if (ref_max_iter < max_iter && !escaped) {
+        return false;
+    }
+
+    // still somewhere on screen, so the offsets stay around a screen wide
+    double extent = 2. * view_extent(view);
+    return fabs(view->pan_x - c_re) < extent && fabs(view->pan_y - c_im) < extent;
+}
+
+static bool reference_usable(const reference_orbit_t* ref, const view_t* view, uint32_t precision_bits, uint32_t max_iter) {
+    return ref && reference_fits(ref->c_re_d, ref->c_im_d, ref->precision_bits, ref->max_iter, ref->escaped, view, precision_bits, max_iter);
+}
+
+// the pending orbit might still escape early, but that can't be counted on
+static bool pending_usable(const gl_reference_t* glref, const view_t* view, uint32_t precision_bits, uint32_t max_iter) {
+    return reference_fits(
+        bignum_to_double(glref->pending_c_re), bignum_to_double(glref->pending_c_im),
+        glref->pending_precision_bits, glref->pending_max_iter, false, view, precision_bits, max_iter
+    );
+}
+
+// largest |dc| on screen: the farthest corner from the pan point (the view
+// isn't centered on it when width != height), plus the pan point's distance
+// from the reference, which reference_usable() keeps under 2 sqrt(2) extents
+static double view_dc_max(const view_t* view) {
+    double far = 0.;
+    for (uint32_t corner = 0; corner < 4; corner++) {
+        double dx, dy;
+        view_pixel_to_delta(view, (corner & 1) ? view->width - 1 : 0, (corner & 2) ? view->height - 1 : 0, &dx, &dy);
+        far = fmax(far, hypot(dx, dy));
+    }
+    return far + 2. * M_SQRT2 * view_extent(view);
+}
+
+// the shader reads steps as { vec2 a; vec2 b; vec2 r; }, r.y unused
+static void upload_bla_steps(gl_reference_t* glref) {
+    uint32_t num_steps = glref->bla->num_steps;
+    float* steps = malloc((size_t) (num_steps ? num_steps : 1) * 6 * sizeof(float));
+    for (uint32_t i = 0; i < num_steps; i++) {
+        const bla_step_t* step = &glref->bla->steps[i];
+        steps[6 * i + 0] = (float) step->a_re;
+        steps[6 * i + 1] = (float) step->a_im;
+        steps[6 * i + 2] = (float) step->b_re;
+        steps[6 * i + 3] = (float) step->b_im;
+        steps[6 * i + 4] = (float) step->r;
+        steps[6 * i + 5] = 0.f;
+    }
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, glref->bla_ssbo);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, (GLsizeiptr) (num_steps ? num_steps : 1) * 6 * sizeof(float), steps, GL_STATIC_DRAW);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, glref->bla_ssbo);
+    free(steps);
+}
+
+static void upload_bla(gl_reference_t* glref, const view_t* view) {
+    // twice what's needed, so zooming out a little doesn't rebuild it
+    double dc_max = 2. * view_dc_max(view);
+    if (glref->bla) {
+        bla_table_destroy(glref->bla);
+    }
+    glref->bla = bla_table_build(glref->ref, dc_max, bla_epsilon(view_pixel_size(view), dc_max, BLA_EPSILON_FLOAT));
+    upload_bla_steps(glref);
+}
+
+// hi + lo into out, down to out's precision
+static void set_double_double(bignum_t* out, double hi, double lo) {
+    bignum_t* tmp = bignum_create(out->num_limbs);
+    bignum_set_double(out, hi);
+    bignum_set_double(tmp, lo);
+    bignum_add(out, out, tmp);
+    bignum_destroy(tmp);
+}
+
+static void* compute_main(void* arg) {
+    gl_reference_t* glref = arg;
+    trace_thread_name("reference orbit");
+    if (glref->pending) {
+        reference_orbit_extend(glref->pending, glref->pending_max_iter, &glref->progress);
+    } else {
+        glref->pending = reference_orbit_compute_parallel(
+            glref->pending_c_re, glref->pending_c_im, glref->pending_precision_bits, glref->pending_max_iter, &glref->progress
+        );
+    }
+    atomic_store_explicit(&glref->pending_done, true, memory_order_release);
+    return NULL;
+}
+
+// a new orbit at view's pan point, or resume (if not NULL) carried on
+static void start_pending(gl_reference_t* glref, const view_t* view, uint32_t precision_bits, uint32_t max_iter, reference_orbit_t* resume) {
+    if (resume) {
+        precision_bits = resume->precision_bits;
+    }
+    glref->pending_c_re = bignum_create(bignum_limbs_for_bits(precision_bits));
+    glref->pending_c_im = bignum_create(bignum_limbs_for_bits(precision_bits));
+    if (resume) {
+        bignum_copy(glref->pending_c_re, resume->c_re);
+        bignum_copy(glref->pending_c_im, resume->c_im);
+    } else {
+        set_double_double(glref->pending_c_re, view->pan_x, view->pan_x_lo);
+        set_double_double(glref->pending_c_im, view->pan_y, view->pan_y_lo);
+    }
+    glref->pending_precision_bits = precision_bits;
+    glref->pending_max_iter = max_iter;
+    glref->pending = resume;
+
+    atomic_init(&glref->progress.iterations, resume ? resume->length : 0);
+    atomic_init(&glref->progress.cancel, false);
+    atomic_init(&glref->pending_done, false);
+    if (pthread_create(&glref->thread, NULL, compute_main, glref) != 0) {
+        // no thread to spare: do it here, the window just stalls meanwhile
+        compute_main(glref);
+        glref->computing = false;
+        return;
+    }
+    glref->computing = true;
+}
+
+// waits for the thread; pending is then the orbit, finished or not
+static void join_pending(gl_reference_t* glref) {
+    if (glref->computing) {
+        pthread_join(glref->thread, NULL);
+        glref->computing = false;
+    }
+    bignum_destroy(glref->pending_c_re);
+    bignum_destroy(glref->pending_c_im);
+    glref->pending_c_re = NULL;
+    glref->pending_c_im = NULL;
+}
+
+static void cancel_pending(gl_reference_t* glref) {
+    if (!glref->computing) {
+        return;
+    }
+    atomic_store_explicit(&glref->progress.cancel, true, memory_order_relaxed);
+    join_pending(glref);
+    // as far as it got is still worth keeping
+    retire(glref, glref->pending, NULL);
+    glref->pending = NULL;
+}
+
+// ref (and bla, if it's not NULL and still covers view) replaces the current
+// orbit, on the GPU too
+static void upload(gl_reference_t* glref, reference_orbit_t* ref, bla_table_t* bla, const view_t* view) {
+    retire_current(glref);
+    glref->ref = ref;
+
+    // the shader's deltas are float, so Z_n may as well be
+    uint32_t length = glref->ref->length;
+    float* orbit = malloc((size_t) length * 2 * sizeof(float));
+    for (uint32_t i = 0; i < 2 * length; i++) {
+        orbit[i] = (float) glref->ref->orbit[i];
+    }
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, glref->ssbo);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, (GLsizeiptr) length * 2 * sizeof(float), orbit, GL_STATIC_DRAW);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, glref->ssbo);
+    free(orbit);
+
+    if (bla && bla->dc_max >= view_dc_max(view)) {
+        glref->bla = bla;
+        upload_bla_steps(glref);
+        return;
+    }
+    if (bla) {
+        bla_table_destroy(bla);
+    }
+    upload_bla(glref, view);
+}
+
+static void upload_pending(gl_reference_t* glref, const view_t* view) {
+    reference_orbit_t* ref = glref->pending;
+    glref->pending = NULL;
+    upload(glref, ref, NULL, view);
+}
+
+bool gl_reference_update(gl_reference_t* glref, const view_t* view) {
+    uint32_t precision_bits = perturb_precision_bits(view_pixel_size(view));
+    uint32_t max_iter = view_max_iter(view);
+
+    if (glref->computing && !pending_usable(glref, view, precision_bits, max_iter)) {
+        // zoomed or panned away from it meanwhile
+        cancel_pending(glref);
+    }
+    if (glref->computing) {
+        if (!atomic_load_explicit(&glref->pending_done, memory_order_acquire)) {
+            return false;
+        }
+        join_pending(glref);
+        upload_pending(glref, view);
+        return true;
+    }
+
+    if (reference_usable(glref->ref, view, precision_bits, max_iter)) {
+        if (glref->bla->dc_max < view_dc_max(view)) {
+            upload_bla(glref, view);
+        }
+        return false;
+    }
+
+    // done with this one; zooming back out may want it again
+    retire_current(glref);
+
+    reference_orbit_t* resume = NULL;
+    if (glref->cache) {
+        bignum_t* c_re = bignum_create(bignum_limbs_for_bits(precision_bits));
+        bignum_t* c_im = bignum_create(bignum_limbs_for_bits(precision_bits));
+        set_double_double(c_re, view->pan_x, view->pan_x_lo);
+        set_double_double(c_im, view->pan_y, view->pan_y_lo);
+        bla_table_t* bla;
+        // as close as reference_fits() asks of it
+        resume = reference_cache_take(glref->cache, c_re, c_im, 2. * view_extent(view), precision_bits, &bla);
+        bignum_destroy(c_im);
+        bignum_destroy(c_re);
+        if (resume && (resume->escaped || resume->max_iter >= max_iter)) {
+            upload(glref, resume, bla, view);
+            return true;
+        }
+        if (bla) {
+            // built over the orbit as it was, not as it'll be
+            bla_table_destroy(bla);
+        }
+    }
+
+    start_pending(glref, view, precision_bits, max_iter, resume);
+    if (!glref->computing) {
+        // ran on this thread after all
+        join_pending(glref);
+        upload_pending(glref, view);
+        return true;
+    }
+    return false;
+}
+
+bool gl_reference_computing(const gl_reference_t* glref, double* out_fraction) {
+    if (!glref->computing) {
+        return false;
+    }
+    if (out_fraction) {
+        uint32_t done = atomic_load_explicit(&glref->progress.iterations, memory_order_relaxed);
+        *out_fraction = (double) done / glref->pending_max_iter;
+    }
+    return true;
+}
+
+void gl_reference_offset(const gl_reference_t* glref, const view_t* view, double* out_dx, double* out_dy) {
+    const reference_orbit_t* ref = glref->ref;
+    bignum_t* d = bignum_create(ref->c_re->num_limbs);
+
+    set_double_double(d, view->pan_x, view->pan_x_lo);
+    bignum_sub(d, d, ref->c_re);
+    *out_dx = bignum_to_double(d);
+
+    set_double_double(d, view->pan_y, view->pan_y_lo);
+    bignum_sub(d, d, ref->c_im);
+    *out_dy = bignum_to_double(d);
+
+    bignum_destroy(d);
+}
@@ -0,0 +1,699 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <inttypes.h>
+#include <math.h>
+
+#include <bla.h>
+#include <camera.h>
+#include <cpu_render.h>
+#include <headless.h>
+#include <image.h>
+#include <kernels.h>
+#include <mandelbrot.h>
+#include <options.h>
+#include <perturbation.h>
+#include <reference_cache.h>
+#include <tile_scheduler.h>
+#include <util.h>
+#include <zoom_video.h>
+
+typedef struct {
+    double avg_time;
+    double best_time;
+    glitch_stats_t glitches;    // of the last frame, all its rects
+} frame_timing_t;
+
+static void add_glitch_stats(glitch_stats_t* total, const glitch_stats_t* stats) {
+    total->glitched += stats->glitched;
+    total->references += stats->references;
+    total->unresolved += stats->unresolved;
+}
+
+// frame k shows the view moved k steps right and down; with reuse, every
+// frame after the first shifts the last one and renders only what that
+// exposed. a (0, 0) step exposes nothing, so those frames render in full
+typedef struct {
+    int32_t step_x, step_y;     // pixels per frame
+    bool reuse;
+} pan_t;
+
+static frame_timing_t time_frames(cpu_renderer_t* renderer, const view_t* base_view, const perturb_frame_t* base_perturb, const pan_t* pan, iter_buffer_t* iters, uint32_t frames) {
+    frame_timing_t timing = { 0 };
+    double total_time = 0.;
+    double pixel_size = view_pixel_size(base_view);
+    view_t prev_view = *base_view;
+
+    for (uint32_t frame = 0; frame < frames; frame++) {
+        double pan_re = (double) frame * pan->step_x * pixel_size;
+        double pan_im = -((double) frame * pan->step_y * pixel_size);
+        camera_t camera;
+        camera_from_view(&camera, base_view);
+        camera_pan(&camera, pan_re, pan_im);
+        view_t view = camera_view(&camera, base_view->width, base_view->height, base_view->max_iter);
+
+        perturb_frame_t perturb;
+        if (base_perturb) {
+            perturb = *base_perturb;
+            perturb.ref_off_x += pan_re;
+            perturb.ref_off_y += pan_im;
+        }
+
+        pixel_rect_t rects[2] = { { 0, 0, view.width, view.height } };
+        uint32_t num_rects = 1;
+
+        double start_time = now_seconds();
+        int32_t dx, dy;
+        if (frame > 0 && pan->reuse && view_pixel_shift(&prev_view, &view, &dx, &dy)
+            && (dx != 0 || dy != 0)) {
+            iter_buffer_shift(iters, dx, dy);
+            num_rects = view_exposed_rects(view.width, view.height, dx, dy, rects);
+        }
+        timing.glitches = (glitch_stats_t) { 0 };
+        for (uint32_t k = 0; k < num_rects; k++) {
+            cpu_renderer_render_rect(renderer, &view, base_perturb ? &perturb : NULL, &rects[k], iters);
+            add_glitch_stats(&timing.glitches, cpu_renderer_glitch_stats(renderer));
+        }
+        double frame_time = now_seconds() - start_time;
+        prev_view = view;
+
+        total_time += frame_time;
+        if (frame == 0 || frame_time < timing.best_time) {
+            timing.best_time = frame_time;
+        }
+    }
+
+    timing.avg_time = total_time / frames;
+    return timing;
+}
+
+static double time_render(cpu_renderer_t* renderer, const view_t* view, const perturb_frame_t* perturb, subdivide_t subdivide, iter_buffer_t* iters) {
+    pixel_rect_t rect = { 0, 0, view->width, view->height };
+    cpu_renderer_set_subdivide(renderer, subdivide);
+    double start_time = now_seconds();
+    cpu_renderer_render_rect(renderer, view, perturb, &rect, iters);
+    return now_seconds() - start_time;
+}
+
+// renders view subdivided into iters, and again without filling anything
+// to check the filled pixels against; plain row by row is timed too
+static void verify_subdivide(cpu_renderer_t* renderer, const view_t* view, const perturb_frame_t* perturb, iter_buffer_t* iters) {
+    iter_buffer_t* check = iter_buffer_create(view->width, view->height);
+
+    double rows_time = time_render(renderer, view, perturb, SUBDIVIDE_OFF, check);
+    time_render(renderer, view, perturb, SUBDIVIDE_SPLIT_ONLY, check);
+    double subdivide_time = time_render(renderer, view, perturb, SUBDIVIDE_ON, iters);
+
+    uint64_t num_pixels = (uint64_t) view->width * view->height;
+    uint64_t wrong = 0;
+    for (uint64_t k = 0; k < num_pixels; k++) {
+        wrong += iters->iter[k] != check->iter[k];
+    }
+    printf(
+        "subdivide: %.3f ms vs %.3f ms row by row (%.2fx), %" PRIu64 " of %" PRIu64 " pixels filled wrong\n",
+        subdivide_time * 1e3, rows_time * 1e3, rows_time / subdivide_time, wrong, num_pixels
+    );
+
+    iter_buffer_destroy(check);
+}
+
+// renders the same view with every isa the CPU has, scalar first so the
+// others can be reported as a speedup over it
+static void isa_bench(cpu_renderer_t* renderer, const view_t* view, iter_buffer_t* iters, uint32_t frames) {
+    double num_pixels = (double) view->width * view->height;
+    double scalar_rate = 0.;
+
+    for (isa_t isa = ISA_SCALAR; isa < ISA_COUNT; isa++) {
+        if (!isa_supported(isa)) {
+            printf("isa %-7s unsupported on this CPU\n", isa_name(isa));
+            continue;
+        }
+
+        cpu_renderer_set_isa(renderer, isa);
+        isa_t frame_isa = cpu_renderer_frame_isa(renderer, view);
+        pan_t no_pan = { 0 };
+        frame_timing_t timing = time_frames(renderer, view, NULL, &no_pan, iters, frames);
+
+        double rate = num_pixels / timing.avg_time;
+        if (isa == ISA_SCALAR) {
+            scalar_rate = rate;
+        }
+
+        printf(
+            "isa %-7s %3" PRIu32 " lanes, avg %9.3f ms, %9.2f Mpixels/s, %5.2fx scalar%s\n",
+            isa_name(isa), isa_lanes(isa), timing.avg_time * 1e3, rate * 1e-6, rate / scalar_rate,
+            (frame_isa != isa) ? " (float precision exhausted, ran scalar)" : ""
+        );
+    }
+}
+
+// the same view with and without the cardioid and bulb test
+static void bulb_bench(cpu_renderer_t* renderer, const view_t* view, const perturb_frame_t* perturb, iter_buffer_t* iters, uint32_t frames) {
+    pan_t no_pan = { 0 };
+
+    cpu_renderer_set_bulb_check(renderer, false);
+    frame_timing_t off = time_frames(renderer, view, perturb, &no_pan, iters, frames);
+    cpu_renderer_set_bulb_check(renderer, true);
+    frame_timing_t on = time_frames(renderer, view, perturb, &no_pan, iters, frames);
+
+    printf("bulb check off: avg %9.3f ms, best %9.3f ms\n", off.avg_time * 1e3, off.best_time * 1e3);
+    printf("bulb check on:  avg %9.3f ms, best %9.3f ms, %5.2fx\n", on.avg_time * 1e3, on.best_time * 1e3, off.avg_time / on.avg_time);
+}
+
+// stats are for the last frame only
+static void print_sched_stats(const tile_scheduler_t* sched) {
+    uint32_t num_workers = tile_scheduler_num_workers(sched);
+    tile_worker_stats_t total = tile_scheduler_total_stats(sched);
+
+    double max_busy = 0.;
+    for (uint32_t w = 0; w < num_workers; w++) {
+        const tile_worker_stats_t* stats = tile_scheduler_worker_stats(sched, w);
+        printf(
+            "sched: worker %3" PRIu32 ": %6" PRIu64 " tiles, %6" PRIu64 " stolen, %8" PRIu64 " failed steals, busy %.3f ms\n",
+            w, stats->tiles, stats->steals, stats->failed_steals, stats->busy_time * 1e3
+        );
+        if (stats->busy_time > max_busy) {
+            max_busy = stats->busy_time;
+        }
+    }
+
+    // 1.0 = every worker was busy for as long as the busiest one
+    double balance = (max_busy > 0.) ? total.busy_time / (max_busy * num_workers) : 1.;
+    printf(
+        "sched: total %" PRIu64 " tiles, %" PRIu64 " stolen (%.1f%%), %" PRIu64 " failed steals, balance %.2f\n",
+        total.tiles, total.steals, total.tiles ? 100. * total.steals / total.tiles : 0.,
+        total.failed_steals, balance
+    );
+}
+
+static bool wants_perturbation(const options_t* opts, const view_t* view) {
+    switch (opts->perturb) {
+    case PERTURB_ON:
+        return true;
+    case PERTURB_OFF:
+        return false;
+    default:
+        return !kernel_double_precision_ok(view);
+    }
+}
+
+// reference point = the pan point, straight from the digits on the command
+// line, so the pixels' deltas need no offset. with a cache, an earlier run's
+// orbit at exactly that point is picked up and only carried on if it's short
+static reference_orbit_t* compute_reference(const options_t* opts, const view_t* view, reference_cache_t* cache) {
+    uint32_t precision_bits = perturb_precision_bits(view_pixel_size(view));
+    bignum_t* c_re = bignum_create(bignum_limbs_for_bits(precision_bits));
+    bignum_t* c_im = bignum_create(bignum_limbs_for_bits(precision_bits));
+    bignum_set_decimal(c_re, opts->pan_re);
+    bignum_set_decimal(c_im, opts->pan_im);
+
+    double start_time = now_seconds();
+    reference_orbit_t* ref = NULL;
+    uint32_t cached_length = 0;
+    if (cache) {
+        bla_table_t* bla;
+        ref = reference_cache_take(cache, c_re, c_im, 0., precision_bits, &bla);
+        if (bla) {
+            // built for the shader's float deltas
+            bla_table_destroy(bla);
+        }
+    }
+    if (ref) {
+        cached_length = ref->length;
+        reference_orbit_extend(ref, view_max_iter(view), NULL);
+    } else {
+        ref = reference_orbit_compute_parallel(c_re, c_im, precision_bits, view_max_iter(view), NULL);
+    }
+    printf(
+        "perturb: reference orbit %" PRIu32 " iterations%s at %" PRIu32 " bits in %.3f ms",
+        ref->length, ref->escaped ? " (escaped)" : "", ref->precision_bits, (now_seconds() - start_time) * 1e3
+    );
+    if (cached_length) {
+        printf(", %" PRIu32 " of them cached", cached_length);
+    }
+    printf("\n");
+
+    bignum_destroy(c_im);
+    bignum_destroy(c_re);
+    return ref;
+}
+
+// the reference sits at the first frame's pan point, so no pixel is further
+// from it than the screen diagonal plus however far the frames pan
+static bla_table_t* compute_bla(const view_t* view, const reference_orbit_t* ref, double pan_distance) {
+    double dc_max = view_pixel_size(view) * hypot((double) view->width, (double) view->height) + pan_distance;
+
+    double start_time = now_seconds();
+    bla_table_t* bla = bla_table_build(ref, dc_max, bla_epsilon(view_pixel_size(view), dc_max, BLA_EPSILON_DOUBLE));
+    printf(
+        "perturb: bla table %" PRIu32 " levels, %" PRIu32 " steps in %.3f ms\n",
+        bla->num_levels, bla->num_steps, (now_seconds() - start_time) * 1e3
+    );
+    return bla;
+}
+
+static cpu_renderer_t* create_renderer(const options_t* opts) {
+    cpu_renderer_t* renderer = cpu_renderer_create(opts->threads, opts->tile_size, opts->isa);
+    cpu_renderer_set_schedule(renderer, opts->schedule);
+    cpu_renderer_set_max_references(renderer, opts->max_refs);
+    cpu_renderer_set_subdivide(renderer, opts->subdivide);
+    cpu_renderer_set_bulb_check(renderer, opts->bulb_check);
+    cpu_renderer_set_period_tolerance(renderer, opts->periodicity ? opts->period_tolerance : 0.);
+    return renderer;
+}
+
+// h:mm:ss
+static void format_duration(double seconds, char* out, size_t out_size) {
+    uint64_t s = (uint64_t) fmax(seconds, 0.);
+    snprintf(out, out_size, "%" PRIu64 ":%02" PRIu64 ":%02" PRIu64, s / 3600, s / 60 % 60, s % 60);
+}
+
+// --export: the image as bands a tile high and the full width, each rendered
+// as a view of its own (camera_view_rect()) and streamed to the writer before
+// the next, so memory is a band's worth however tall the image gets. the
+// reference orbit and BLA table are computed once, for the whole image
+static int32_t export_image(const options_t* opts, const camera_t* camera) {
+    view_t view = camera_view(camera, opts->width, opts->height, opts->max_iter);
+    uint32_t band_height = opts->tile_size ? opts->tile_size : CPU_DEFAULT_TILE_SIZE;
+    band_height = (band_height < view.height) ? band_height : view.height;
+
+    cpu_renderer_t* renderer = create_renderer(opts);
+    iter_buffer_t* iters = iter_buffer_create(view.width, band_height);
+    framebuffer_t* fb = framebuffer_create(view.width, band_height);
+
+    printf(
+        "export: %" PRIu32 "x%" PRIu32 ", %gx zoom, max_iter %" PRIu32 ", %" PRIu32 " threads, %" PRIu32 " rows per band\n",
+        view.width, view.height, view.zoom, view_max_iter(&view), cpu_renderer_num_threads(renderer), band_height
+    );
+
+    reference_cache_t* ref_cache = opts->ref_cache_dir ? reference_cache_create((size_t) opts->ref_cache_mb << 20, opts->ref_cache_dir) : NULL;
+    reference_orbit_t* ref = wants_perturbation(opts, &view) ? compute_reference(opts, &view, ref_cache) : NULL;
+    bla_table_t* bla = (ref && opts->bla) ? compute_bla(&view, ref, 0.) : NULL;
+    glitch_stats_t glitches = { 0 };
+
+    palette_t palette = palette_preset(opts->palette);
+    palette.exposure = opts->exposure;
+
+    int32_t status = 0;
+    image_writer_t* writer = image_writer_open(opts->export_path, view.width, view.height);
+    if (!writer) {
+        fprintf(stderr, "Failed to create %s\n", opts->export_path);
+        status = -1;
+    }
+
+    double start_time = now_seconds();
+    double write_time = 0.;
+    double last_report = start_time;
+    for (uint32_t y0 = 0; writer && y0 < view.height; y0 += band_height) {
+        uint32_t y1 = (y0 + band_height < view.height) ? y0 + band_height : view.height;
+        pixel_rect_t band_rect = { 0, y0, view.width, y1 };
+        view_t band = camera_view_rect(camera, view.width, view.height, &band_rect, opts->max_iter);
+
+        // the last band is shorter; the buffers only shrink their view of it
+        iters->height = y1 - y0;
+        fb->height = y1 - y0;
+        pixel_rect_t all = { 0, 0, band.width, band.height };
+        perturb_frame_t perturb = {
+            .ref = ref,
+            .bla = bla,
+            // hi parts first: they're close, so that difference is exact
+            .ref_off_x = (band.pan_x - view.pan_x) + (band.pan_x_lo - view.pan_x_lo),
+            .ref_off_y = (band.pan_y - view.pan_y) + (band.pan_y_lo - view.pan_y_lo),
+        };
+        cpu_renderer_render_rect(renderer, &band, ref ? &perturb : NULL, &all, iters);
+        if (ref) {
+            add_glitch_stats(&glitches, cpu_renderer_glitch_stats(renderer));
+        }
+        cpu_renderer_colorize(renderer, iters, &palette, fb);
+
+        double write_start = now_seconds();
+        if (!image_writer_write(writer, fb)) {
+            fprintf(stderr, "\nFailed to write %s\n", opts->export_path);
+            status = -1;
+            break;
+        }
+        double now = now_seconds();
+        write_time += now - write_start;
+
+        // rows take longer deep in the set than out of it, so this is rough
+        if (now - last_report >= .5 || y1 == view.height) {
+            double fraction = (double) y1 / view.height;
+            double elapsed = now - start_time;
+            char eta[32];
+            format_duration(elapsed / fraction - elapsed, eta, sizeof(eta));
+            fprintf(
+                stderr, "\rexport: %5.1f%%, %.2f Mpixels/s, %s left ",
+                fraction * 1e2, (double) view.width * y1 / elapsed * 1e-6, eta
+            );
+            last_report = now;
+        }
+    }
+
+    if (writer) {
+        if (!image_writer_close(writer) && status == 0) {
+            fprintf(stderr, "\nFailed to write %s\n", opts->export_path);
+            status = -1;
+        }
+        double total_time = now_seconds() - start_time;
+        char elapsed[32];
+        format_duration(total_time, elapsed, sizeof(elapsed));
+        fprintf(stderr, "\n");
+        printf(
+            "export: %s in %s (%.3f s), %.2f Mpixels/s, %.3f s of it writing\n",
+            opts->export_path, elapsed, total_time, (double) view.width * view.height / total_time * 1e-6, write_time
+        );
+    }
+    if (ref) {
+        printf(
+            "perturb: %" PRIu32 " glitched pixels, %" PRIu32 " secondary references, %" PRIu32 " unresolved\n",
+            glitches.glitched, glitches.references, glitches.unresolved
+        );
+    }
+
+    if (bla) {
+        bla_table_destroy(bla);
+    }
+    if (ref && ref_cache) {
+        reference_cache_put(ref_cache, ref, NULL);
+    } else if (ref) {
+        reference_orbit_destroy(ref);
+    }
+    if (ref_cache) {
+        reference_cache_destroy(ref_cache);
+    }
+    fb->height = band_height;
+    iters->height = band_height;
+    framebuffer_destroy(fb);
+    iter_buffer_destroy(iters);
+    cpu_renderer_destroy(renderer);
+    return status;
+}
+
+// keyframe k of a video starting at start_zoom: zoom start_zoom / 2^k, at
+// twice the frame size. ref, computed for the deepest keyframe, serves every
+// one deep enough to want it, from the same pan point
+static void render_keyframe(cpu_renderer_t* renderer, const options_t* opts, const camera_t* camera, uint32_t k, uint32_t max_iter, const reference_orbit_t* ref, const palette_t* palette, iter_buffer_t* iters, framebuffer_t* fb, zoom_keyframe_t* out) {
+    camera_t keyframe_camera = *camera;
+    keyframe_camera.zoom_log2 = log2(opts->video_start_zoom) - k;
+    view_t view = camera_view(&keyframe_camera, 2 * opts->width, 2 * opts->height, max_iter);
+
+    pixel_rect_t all = { 0, 0, view.width, view.height };
+    if (ref && wants_perturbation(opts, &view)) {
+        double dc_max = view_pixel_size(&view) * hypot(view.width, view.height);
+        bla_table_t* bla = opts->bla ? bla_table_build(ref, dc_max, bla_epsilon(view_pixel_size(&view), dc_max, BLA_EPSILON_DOUBLE)) : NULL;
+        perturb_frame_t perturb = { .ref = ref, .bla = bla };
+        cpu_renderer_render_rect(renderer, &view, &perturb, &all, iters);
+        if (bla) {
+            bla_table_destroy(bla);
+        }
+    } else {
+        cpu_renderer_render_rect(renderer, &view, NULL, &all, iters);
+    }
+    cpu_renderer_colorize(renderer, iters, palette, fb);
+
+    out->view = view;
+    out->fb = fb;
+}
+
+// pattern is handed to snprintf() with the frame number, so it may hold one
+// %d (%0Nd for padding) and otherwise only %%
+static bool video_pattern_ok(const char* pattern) {
+    uint32_t conversions = 0;
+    for (const char* p = pattern; *p; p++) {
+        if (*p != '%') {
+            continue;
+        }
+        p++;
+        if (*p == '%') {
+            continue;
+        }
+        if (*p == '0') {
+            p++;
+        }
+        while (*p >= '0' && *p <= '9') {
+            p++;
+        }
+        if (*p != 'd') {
+            return false;
+        }
+        conversions++;
+    }
+    return conversions == 1;
+}
+
+// --video: frame i is at zoom start / 2^(i / frames_per_octave), the last one
+// at --zoom exactly. each comes out of keyframes k and k + 1 (k the octave it
+// falls in), and those are rendered as the frames reach them, so only two are
+// ever held. every keyframe has the final frame's max_iter, so the colors
+// don't shift as the video goes in
+static int32_t render_video(const options_t* opts, camera_t* camera) {
+    double octaves = log2(opts->video_start_zoom / opts->zoom);
+    if (!(octaves > 0.)) {
+        fprintf(stderr, "--video-start has to be bigger than --zoom\n");
+        return -1;
+    }
+    bool to_stdout = strcmp(opts->video, "-") == 0;
+    if (!to_stdout && !video_pattern_ok(opts->video)) {
+        fprintf(stderr, "--video needs exactly one %%d (or %%0Nd) and no other %% but %%%%, or - for stdout\n");
+        return -1;
+    }
+
+    // raw frames get stdout to themselves; everything printed goes to stderr
+    FILE* pipe = NULL;
+    if (to_stdout) {
+        fflush(stdout);
+        int fd = dup(STDOUT_FILENO);
+        pipe = (fd >= 0) ? fdopen(fd, "wb") : NULL;
+        if (!pipe) {
+            if (fd >= 0) {
+                close(fd);
+            }
+            fprintf(stderr, "Failed to open stdout for the frames\n");
+            return -1;
+        }
+        dup2(STDERR_FILENO, STDOUT_FILENO);
+    }
+
+    uint32_t num_frames = (uint32_t) ceil(octaves * opts->frames_per_octave) + 1;
+    uint32_t num_keyframes = (uint32_t) floor(octaves) + 2;
+    view_t last_frame = camera_view(camera, opts->width, opts->height, opts->max_iter);
+    uint32_t max_iter = view_max_iter(&last_frame);
+
+    cpu_renderer_t* renderer = create_renderer(opts);
+    iter_buffer_t* iters = iter_buffer_create(2 * opts->width, 2 * opts->height);
+    framebuffer_t* keyframe_fbs[2] = {
+        framebuffer_create(2 * opts->width, 2 * opts->height),
+        framebuffer_create(2 * opts->width, 2 * opts->height),
+    };
+    framebuffer_t* fb = framebuffer_create(opts->width, opts->height);
+    palette_t palette = palette_preset(opts->palette);
+    palette.exposure = opts->exposure;
+
+    printf(
+        "video: %" PRIu32 "x%" PRIu32 ", %gx to %gx zoom, %" PRIu32 " frames from %" PRIu32 " keyframes at %" PRIu32 "x%" PRIu32 ", max_iter %" PRIu32 "\n",
+        opts->width, opts->height, opts->video_start_zoom, opts->zoom, num_frames, num_keyframes, 2 * opts->width, 2 * opts->height, max_iter
+    );
+
+    // the deepest keyframe's orbit is good for all of them
+    camera_t deepest = *camera;
+    deepest.zoom_log2 = log2(opts->video_start_zoom) - (num_keyframes - 1);
+    view_t deepest_view = camera_view(&deepest, 2 * opts->width, 2 * opts->height, max_iter);
+    reference_cache_t* ref_cache = opts->ref_cache_dir ? reference_cache_create((size_t) opts->ref_cache_mb << 20, opts->ref_cache_dir) : NULL;
+    reference_orbit_t* ref = wants_perturbation(opts, &deepest_view) ? compute_reference(opts, &deepest_view, ref_cache) : NULL;
+
+    zoom_keyframe_t keyframes[2];
+    uint32_t outer_k = 0;
+    double start_time = now_seconds();
+    double keyframe_time = 0.;
+    double last_report = start_time;
+    int32_t status = 0;
+
+    double keyframe_start = now_seconds();
+    render_keyframe(renderer, opts, camera, 0, max_iter, ref, &palette, iters, keyframe_fbs[0], &keyframes[0]);
+    render_keyframe(renderer, opts, camera, 1, max_iter, ref, &palette, iters, keyframe_fbs[1], &keyframes[1]);
+    keyframe_time += now_seconds() - keyframe_start;
+
+    for (uint32_t i = 0; i < num_frames; i++) {
+        double zoom_log2 = log2(opts->video_start_zoom) - (double) i / opts->frames_per_octave;
+        if (i == num_frames - 1) {
+            zoom_log2 = log2(opts->zoom);
+        }
+        uint32_t k = (uint32_t) floor(log2(opts->video_start_zoom) - zoom_log2 + 1e-9);
+
+        // one octave further in: the inner keyframe becomes the outer one
+        while (outer_k < k) {
+            outer_k++;
+            framebuffer_t* spare = keyframe_fbs[0];
+            keyframe_fbs[0] = keyframe_fbs[1];
+            keyframe_fbs[1] = spare;
+            keyframes[0] = keyframes[1];
+            keyframe_start = now_seconds();
+            render_keyframe(renderer, opts, camera, outer_k + 1, max_iter, ref, &palette, iters, keyframe_fbs[1], &keyframes[1]);
+            keyframe_time += now_seconds() - keyframe_start;
+        }
+
+        camera_t frame_camera = *camera;
+        frame_camera.zoom_log2 = zoom_log2;
+        view_t frame = camera_view(&frame_camera, opts->width, opts->height, max_iter);
+        zoom_video_frame(&keyframes[0], &keyframes[1], &frame, fb);
+
+        if (pipe) {
+            size_t num_bytes = (size_t) fb->width * fb->height * 3;
+            if (fwrite(fb->pixels, 1, num_bytes, pipe) != num_bytes) {
+                fprintf(stderr, "\nFailed to write frame %" PRIu32 "\n", i);
+                status = -1;
+                break;
+            }
+        } else {
+            char path[4096];
+            snprintf(path, sizeof(path), opts->video, i);
+            image_writer_t* writer = image_writer_open(path, fb->width, fb->height);
+            bool ok = writer && image_writer_write(writer, fb);
+            if (writer) {
+                ok = image_writer_close(writer) && ok;
+            }
+            if (!ok) {
+                fprintf(stderr, "\nFailed to write %s\n", path);
+                status = -1;
+                break;
+            }
+        }
+
+        double now = now_seconds();
+        if (now - last_report >= .5 || i == num_frames - 1) {
+            double elapsed = now - start_time;
+            char eta[32];
+            format_duration(elapsed / (i + 1) * (num_frames - i - 1), eta, sizeof(eta));
+            fprintf(
+                stderr, "\rvideo: frame %" PRIu32 "/%" PRIu32 ", keyframe %" PRIu32 "/%" PRIu32 ", %s left ",
+                i + 1, num_frames, outer_k + 2, num_keyframes, eta
+            );
+            last_report = now;
+        }
+    }
+
+    double total_time = now_seconds() - start_time;
+    fprintf(stderr, "\n");
+    printf(
+        "video: %.3f s, %.3f s of it rendering keyframes, %.2f frames/s\n",
+        total_time, keyframe_time, num_frames / total_time
+    );
+
+    if (ref && ref_cache) {
+        reference_cache_put(ref_cache, ref, NULL);
+    } else if (ref) {
+        reference_orbit_destroy(ref);
+    }
+    if (ref_cache) {
+        reference_cache_destroy(ref_cache);
+    }
+    if (pipe && fclose(pipe) != 0) {
+        status = -1;
+    }
+    framebuffer_destroy(fb);
+    framebuffer_destroy(keyframe_fbs[1]);
+    framebuffer_destroy(keyframe_fbs[0]);
+    iter_buffer_destroy(iters);
+    cpu_renderer_destroy(renderer);
+    return status;
+}
+
+int32_t headless_run(const options_t* opts) {
+    camera_t camera;
+    camera_init(&camera, opts->pan_x, opts->pan_y, opts->zoom);
+    camera_set_center_decimal(&camera, opts->pan_re, opts->pan_im);
+    if (opts->export_path) {
+        return export_image(opts, &camera);
+    }
+    if (opts->video) {
+        return render_video(opts, &camera);
+    }
+    view_t view = camera_view(&camera, opts->width, opts->height, opts->max_iter);
+
+    cpu_renderer_t* renderer = create_renderer(opts);
+    iter_buffer_t* iters = iter_buffer_create(view.width, view.height);
+    framebuffer_t* fb = framebuffer_create(view.width, view.height);
+
+    printf(
+        "cpu: %" PRIu32 "x%" PRIu32 ", %gx zoom, max_iter %" PRIu32 ", %" PRIu32 " threads\n",
+        view.width, view.height, view.zoom, view_max_iter(&view), cpu_renderer_num_threads(renderer)
+    );
+
+    // only worth having if it outlives the run
+    reference_cache_t* ref_cache = opts->ref_cache_dir ? reference_cache_create((size_t) opts->ref_cache_mb << 20, opts->ref_cache_dir) : NULL;
+    reference_orbit_t* ref = wants_perturbation(opts, &view) ? compute_reference(opts, &view, ref_cache) : NULL;
+    pan_t pan = {
+        .step_x = opts->pan_step_x,
+        .step_y = opts->pan_step_y,
+        .reuse = opts->pan_reuse,
+    };
+    double pan_distance = opts->frames * hypot(pan.step_x, pan.step_y) * view_pixel_size(&view);
+    bla_table_t* bla = (ref && opts->bla) ? compute_bla(&view, ref, pan_distance) : NULL;
+    perturb_frame_t perturb = {
+        .ref = ref,
+        .bla = bla,
+        .ref_off_x = 0.,
+        .ref_off_y = 0.,
+    };
+
+    // the benches render whole frames, so the renderer's stats are a frame's;
+    // time_frames() adds up a panned frame's strips itself
+    const glitch_stats_t* glitches = cpu_renderer_glitch_stats(renderer);
+    frame_timing_t timing;
+    if (opts->subdivide_verify) {
+        verify_subdivide(renderer, &view, ref ? &perturb : NULL, iters);
+    } else if (opts->bulb_bench) {
+        bulb_bench(renderer, &view, ref ? &perturb : NULL, iters, opts->frames);
+    } else if (opts->isa_bench && !ref) {
+        isa_bench(renderer, &view, iters, opts->frames);
+    } else {
+        timing = time_frames(renderer, &view, ref ? &perturb : NULL, &pan, iters, opts->frames);
+        double num_pixels = (double) view.width * view.height;
+        printf(
+            "cpu: %s, %" PRIu32 " frames, avg %.3f ms, best %.3f ms (%.2f Mpixels/s)\n",
+            bla ? "perturbed+bla" : ref ? "perturbed" : isa_name(cpu_renderer_frame_isa(renderer, &view)), opts->frames,
+            timing.avg_time * 1e3, timing.best_time * 1e3, num_pixels / timing.avg_time * 1e-6
+        );
+        glitches = &timing.glitches;
+    }
+
+    if (ref) {
+        printf(
+            "perturb: %" PRIu32 " glitched pixels, %" PRIu32 " secondary references, %" PRIu32 " unresolved\n",
+            glitches->glitched, glitches->references, glitches->unresolved
+        );
+    }
+
+    if (opts->sched_stats && opts->schedule == SCHEDULE_STEAL) {
+        print_sched_stats(cpu_renderer_scheduler(renderer));
+    }
+
+    // coloring is a pass of its own; timed to show what a palette change costs
+    palette_t palette = palette_preset(opts->palette);
+    palette.exposure = opts->exposure;
+    double colorize_start = now_seconds();
+    cpu_renderer_colorize(renderer, iters, &palette, fb);
+    printf("cpu: colorize %.3f ms\n", (now_seconds() - colorize_start) * 1e3);
+
+    int32_t status = 0;
+    if (opts->output && !image_write_ppm(opts->output, fb)) {
+        fprintf(stderr, "Failed to write %s\n", opts->output);
+        status = -1;
+    }
+
+    if (bla) {
+        bla_table_destroy(bla);
+    }
+    if (ref && ref_cache) {
+        reference_cache_put(ref_cache, ref, NULL);
+    } else if (ref) {
+        reference_orbit_destroy(ref);
+    }
+    if (ref_cache) {
+        reference_cache_destroy(ref_cache);
+    }
+    framebuffer_destroy(fb);
+    iter_buffer_destroy(iters);
+    cpu_renderer_destroy(renderer);
+    return status;
+}
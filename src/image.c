@@ -0,0 +1,288 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdbool.h>
+#include <inttypes.h>
+
+#include <zlib.h>
+
+#include <image.h>
+
+bool image_write_ppm(const char* filename, const framebuffer_t* fb) {
+    FILE* f = fopen(filename, "wb");
+    if (!f) {
+        return false;
+    }
+
+    fprintf(f, "P6\n%" PRIu32 " %" PRIu32 "\n255\n", fb->width, fb->height);
+
+    size_t num_bytes = (size_t) fb->width * fb->height * 3;
+    bool ok = fwrite(fb->pixels, 1, num_bytes, f) == num_bytes;
+
+    return (fclose(f) == 0) && ok;
+}
+
+typedef enum {
+    IMAGE_FORMAT_PPM,
+    IMAGE_FORMAT_PNG,
+    IMAGE_FORMAT_TIFF,
+} image_format_t;
+
+// deflate output goes out as an IDAT chunk each time this much piles up
+#define PNG_CHUNK_SIZE (256u << 10)
+// TIFF strips are only offsets into the pixel data, so their size doesn't
+// change what the writer holds; it's what a reader has to
+#define TIFF_ROWS_PER_STRIP 16u
+// header, then the pixels, then the IFD
+#define TIFF_HEADER_SIZE 16u
+#define TIFF_NUM_TAGS 10u
+
+struct image_writer {
+    FILE* f;
+    image_format_t format;
+    uint32_t width, height;
+    uint32_t rows_written;
+    bool ok;
+
+    // png: one filtered row at a time into zs, out collects what comes out
+    z_stream zs;
+    uint8_t* row;
+    uint8_t* out;
+};
+
+static bool has_suffix(const char* s, const char* suffix) {
+    size_t len = strlen(s);
+    size_t suffix_len = strlen(suffix);
+    return len >= suffix_len && strcasecmp(s + len - suffix_len, suffix) == 0;
+}
+
+static void put_u16_le(uint8_t* p, uint16_t v) {
+    p[0] = (uint8_t) v;
+    p[1] = (uint8_t) (v >> 8);
+}
+
+static void put_u32_le(uint8_t* p, uint32_t v) {
+    put_u16_le(p, (uint16_t) v);
+    put_u16_le(p + 2, (uint16_t) (v >> 16));
+}
+
+static void put_u64_le(uint8_t* p, uint64_t v) {
+    put_u32_le(p, (uint32_t) v);
+    put_u32_le(p + 4, (uint32_t) (v >> 32));
+}
+
+static void put_u32_be(uint8_t* p, uint32_t v) {
+    p[0] = (uint8_t) (v >> 24);
+    p[1] = (uint8_t) (v >> 16);
+    p[2] = (uint8_t) (v >> 8);
+    p[3] = (uint8_t) v;
+}
+
+static void png_chunk(image_writer_t* writer, const char* type, const uint8_t* data, uint32_t size) {
+    uint8_t header[8];
+    put_u32_be(header, size);
+    memcpy(header + 4, type, 4);
+    uLong crc = crc32(0, header + 4, 4);
+    if (size > 0) {
+        // crc32() with no data hands back its initial value, not crc
+        crc = crc32(crc, data, size);
+    }
+    uint8_t trailer[4];
+    put_u32_be(trailer, (uint32_t) crc);
+
+    writer->ok = writer->ok
+        && fwrite(header, 1, sizeof(header), writer->f) == sizeof(header)
+        && fwrite(data, 1, size, writer->f) == size
+        && fwrite(trailer, 1, sizeof(trailer), writer->f) == sizeof(trailer);
+}
+
+// runs zs until it wants more input (or, finishing, until it's done),
+// writing out every chunk that fills up on the way
+static void png_deflate(image_writer_t* writer, int flush) {
+    int status;
+    do {
+        status = deflate(&writer->zs, flush);
+        if (writer->zs.avail_out == 0 || (flush == Z_FINISH && status == Z_STREAM_END)) {
+            png_chunk(writer, "IDAT", writer->out, PNG_CHUNK_SIZE - writer->zs.avail_out);
+            writer->zs.next_out = writer->out;
+            writer->zs.avail_out = PNG_CHUNK_SIZE;
+        }
+    } while (status == Z_OK && (writer->zs.avail_in > 0 || flush == Z_FINISH));
+    writer->ok = writer->ok && status != Z_STREAM_ERROR;
+}
+
+static void png_begin(image_writer_t* writer) {
+    static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    writer->ok = fwrite(signature, 1, sizeof(signature), writer->f) == sizeof(signature);
+
+    // 8 bit RGB, no interlacing
+    uint8_t ihdr[13] = { 0 };
+    put_u32_be(ihdr, writer->width);
+    put_u32_be(ihdr + 4, writer->height);
+    ihdr[8] = 8;
+    ihdr[9] = 2;
+    png_chunk(writer, "IHDR", ihdr, sizeof(ihdr));
+
+    writer->row = malloc((size_t) writer->width * 3 + 1);
+    writer->out = malloc(PNG_CHUNK_SIZE);
+    memset(&writer->zs, 0, sizeof(writer->zs));
+    writer->ok = writer->ok && deflateInit(&writer->zs, Z_DEFAULT_COMPRESSION) == Z_OK;
+    writer->zs.next_out = writer->out;
+    writer->zs.avail_out = PNG_CHUNK_SIZE;
+}
+
+static void png_write_row(image_writer_t* writer, const uint8_t* rgb) {
+    // the sub filter: each byte minus the one a pixel to its left, which
+    // turns the palette's smooth ramps into long runs for deflate
+    size_t row_bytes = (size_t) writer->width * 3;
+    writer->row[0] = 1;
+    memcpy(writer->row + 1, rgb, 3);
+    for (size_t i = 3; i < row_bytes; i++) {
+        writer->row[i + 1] = (uint8_t) (rgb[i] - rgb[i - 3]);
+    }
+
+    writer->zs.next_in = writer->row;
+    writer->zs.avail_in = (uInt) (row_bytes + 1);
+    png_deflate(writer, Z_NO_FLUSH);
+}
+
+static void png_end(image_writer_t* writer) {
+    png_deflate(writer, Z_FINISH);
+    deflateEnd(&writer->zs);
+    png_chunk(writer, "IEND", NULL, 0);
+    free(writer->out);
+    free(writer->row);
+}
+
+static uint64_t tiff_pixel_bytes(const image_writer_t* writer) {
+    return (uint64_t) writer->width * writer->height * 3;
+}
+
+// little endian BigTIFF; the pixels are a known size, so the IFD's offset
+// can go in before any of them
+static void tiff_begin(image_writer_t* writer) {
+    uint8_t header[TIFF_HEADER_SIZE];
+    memcpy(header, "II", 2);
+    put_u16_le(header + 2, 43);
+    put_u16_le(header + 4, 8);
+    put_u16_le(header + 6, 0);
+    put_u64_le(header + 8, TIFF_HEADER_SIZE + tiff_pixel_bytes(writer));
+    writer->ok = fwrite(header, 1, sizeof(header), writer->f) == sizeof(header);
+}
+
+static void tiff_tag(uint8_t* entry, uint16_t tag, uint16_t type, uint64_t count, uint64_t value) {
+    put_u16_le(entry, tag);
+    put_u16_le(entry + 2, type);
+    put_u64_le(entry + 4, count);
+    put_u64_le(entry + 12, value);
+}
+
+static void tiff_end(image_writer_t* writer) {
+    enum { SHORT = 3, LONG = 4, LONG8 = 16 };
+    uint32_t num_strips = (writer->height + TIFF_ROWS_PER_STRIP - 1) / TIFF_ROWS_PER_STRIP;
+    uint64_t strip_bytes = (uint64_t) writer->width * 3 * TIFF_ROWS_PER_STRIP;
+    uint64_t ifd_offset = TIFF_HEADER_SIZE + tiff_pixel_bytes(writer);
+    uint64_t ifd_size = 8 + TIFF_NUM_TAGS * 20 + 8;
+    // one strip's offset and size fit in their tags, more go after the IFD
+    uint64_t offsets_at = (num_strips == 1) ? TIFF_HEADER_SIZE : ifd_offset + ifd_size;
+    uint64_t counts_at = (num_strips == 1) ? tiff_pixel_bytes(writer) : offsets_at + 8 * (uint64_t) num_strips;
+
+    uint8_t ifd[8 + TIFF_NUM_TAGS * 20 + 8] = { 0 };
+    uint8_t bits_per_sample[8] = { 0 };
+    put_u16_le(bits_per_sample, 8);
+    put_u16_le(bits_per_sample + 2, 8);
+    put_u16_le(bits_per_sample + 4, 8);
+
+    // tags have to be in ascending order; SHORT values sit in the low bytes
+    put_u64_le(ifd, TIFF_NUM_TAGS);
+    uint8_t* entry = ifd + 8;
+    tiff_tag(entry + 0 * 20, 256, LONG, 1, writer->width);         // ImageWidth
+    tiff_tag(entry + 1 * 20, 257, LONG, 1, writer->height);        // ImageLength
+    tiff_tag(entry + 2 * 20, 258, SHORT, 3, 0);                    // BitsPerSample
+    memcpy(entry + 2 * 20 + 12, bits_per_sample, 8);
+    tiff_tag(entry + 3 * 20, 259, SHORT, 1, 1);                    // Compression: none
+    tiff_tag(entry + 4 * 20, 262, SHORT, 1, 2);                    // PhotometricInterpretation: RGB
+    tiff_tag(entry + 5 * 20, 273, LONG8, num_strips, offsets_at);  // StripOffsets
+    tiff_tag(entry + 6 * 20, 277, SHORT, 1, 3);                    // SamplesPerPixel
+    tiff_tag(entry + 7 * 20, 278, LONG, 1, TIFF_ROWS_PER_STRIP);   // RowsPerStrip
+    tiff_tag(entry + 8 * 20, 279, LONG8, num_strips, counts_at);   // StripByteCounts
+    tiff_tag(entry + 9 * 20, 284, SHORT, 1, 1);                    // PlanarConfiguration: chunky
+    writer->ok = writer->ok && fwrite(ifd, 1, sizeof(ifd), writer->f) == sizeof(ifd);
+    if (num_strips == 1) {
+        return;
+    }
+
+    // every strip is full but the last
+    for (uint32_t i = 0; i < num_strips && writer->ok; i++) {
+        uint8_t v[8];
+        put_u64_le(v, TIFF_HEADER_SIZE + i * strip_bytes);
+        writer->ok = fwrite(v, 1, sizeof(v), writer->f) == sizeof(v);
+    }
+    for (uint32_t i = 0; i < num_strips && writer->ok; i++) {
+        uint8_t v[8];
+        uint64_t remaining = tiff_pixel_bytes(writer) - i * strip_bytes;
+        put_u64_le(v, (remaining < strip_bytes) ? remaining : strip_bytes);
+        writer->ok = fwrite(v, 1, sizeof(v), writer->f) == sizeof(v);
+    }
+}
+
+image_writer_t* image_writer_open(const char* filename, uint32_t width, uint32_t height) {
+    FILE* f = fopen(filename, "wb");
+    if (!f) {
+        return NULL;
+    }
+
+    image_writer_t* writer = calloc(1, sizeof(*writer));
+    writer->f = f;
+    writer->width = width;
+    writer->height = height;
+    writer->ok = true;
+
+    if (has_suffix(filename, ".png")) {
+        writer->format = IMAGE_FORMAT_PNG;
+        png_begin(writer);
+    } else if (has_suffix(filename, ".tif") || has_suffix(filename, ".tiff")) {
+        writer->format = IMAGE_FORMAT_TIFF;
+        tiff_begin(writer);
+    } else {
+        writer->format = IMAGE_FORMAT_PPM;
+        writer->ok = fprintf(f, "P6\n%" PRIu32 " %" PRIu32 "\n255\n", width, height) > 0;
+    }
+    return writer;
+}
+
+bool image_writer_write(image_writer_t* writer, const framebuffer_t* rows) {
+    if (rows->width != writer->width || rows->height > writer->height - writer->rows_written) {
+        writer->ok = false;
+    }
+    if (!writer->ok) {
+        return false;
+    }
+
+    size_t row_bytes = (size_t) rows->width * 3;
+    if (writer->format == IMAGE_FORMAT_PNG) {
+        for (uint32_t y = 0; y < rows->height; y++) {
+            png_write_row(writer, &rows->pixels[y * row_bytes]);
+        }
+    } else {
+        // PPM and the TIFF strips are the pixels as they are
+        size_t num_bytes = row_bytes * rows->height;
+        writer->ok = fwrite(rows->pixels, 1, num_bytes, writer->f) == num_bytes;
+    }
+    writer->rows_written += rows->height;
+    return writer->ok;
+}
+
+bool image_writer_close(image_writer_t* writer) {
+    bool complete = writer->rows_written == writer->height;
+    if (writer->format == IMAGE_FORMAT_PNG) {
+        png_end(writer);
+    } else if (writer->format == IMAGE_FORMAT_TIFF && complete) {
+        tiff_end(writer);
+    }
+
+    bool ok = (fclose(writer->f) == 0) && writer->ok && complete;
+    free(writer);
+    return ok;
+}
@@ -0,0 +1,264 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <inttypes.h>
+#include <math.h>
+
+#include <GLFW/glfw3.h>
+
+#include <callbacks.h>
+#include <camera.h>
+#include <input_replay.h>
+#include <util.h>
+
+#define LOG_MAGIC "mandelbrot-input 1"
+
+extern uint8_t view_dirty;      // src/callbacks.c
+extern uint8_t palette_dirty;
+
+// an event the callbacks took, and how long it took to show. latency is NAN
+// until a frame shows it, and stays < 0 if it never needed one
+typedef struct {
+    input_event_type_t type;
+    double time;
+    double latency;
+} handled_event_t;
+
+static bool active = false;
+static double start_time;
+
+static FILE* record_file = NULL;
+
+static bool replaying = false;
+static bool replay_fast;
+static bool replay_started = false;
+static input_event_t* script = NULL;
+static uint32_t script_length = 0;
+static uint32_t script_next = 0;
+
+static handled_event_t* handled = NULL;
+static uint32_t num_handled = 0;
+static uint32_t handled_capacity = 0;
+// handled[first_unshown, num_handled) might still be waiting for a frame
+static uint32_t first_unshown = 0;
+static uint32_t num_unshown = 0;
+
+static const char* event_name(input_event_type_t type) {
+    switch (type) {
+    case INPUT_EVENT_SCROLL:
+        return "scroll";
+    case INPUT_EVENT_CURSOR_POS:
+        return "cursor";
+    case INPUT_EVENT_MOUSE_BUTTON:
+        return "button";
+    }
+    return "?";
+}
+
+bool input_record_start(const char* path, uint32_t width, uint32_t height, const camera_t* camera) {
+    record_file = fopen(path, "w");
+    if (!record_file) {
+        return false;
+    }
+    fprintf(record_file, LOG_MAGIC "\n");
+    fprintf(record_file, "window %" PRIu32 " %" PRIu32 "\n", width, height);
+    fprintf(
+        record_file, "camera %a %a %a %a %a\n",
+        camera->re_hi, camera->re_lo, camera->im_hi, camera->im_lo, camera->zoom_log2
+    );
+    active = true;
+    start_time = glfwGetTime();
+    return true;
+}
+
+bool input_replay_load(const char* path, bool fast, uint32_t* out_width, uint32_t* out_height, camera_t* out_camera) {
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        return false;
+    }
+
+    char line[512];
+    camera_t camera;
+    bool ok = fgets(line, sizeof(line), f) && strncmp(line, LOG_MAGIC, strlen(LOG_MAGIC)) == 0
+        && fgets(line, sizeof(line), f) && sscanf(line, "window %" SCNu32 " %" SCNu32, out_width, out_height) == 2
+        && fgets(line, sizeof(line), f)
+        && sscanf(line, "camera %lf %lf %lf %lf %lf", &camera.re_hi, &camera.re_lo, &camera.im_hi, &camera.im_lo, &camera.zoom_log2) == 5;
+
+    uint32_t capacity = 0;
+    while (ok && fgets(line, sizeof(line), f)) {
+        input_event_t event = { 0 };
+        char name[16];
+        int consumed = 0;
+        if (sscanf(line, "%lf %15s %n", &event.time, name, &consumed) != 2) {
+            ok = false;
+            break;
+        }
+        const char* args = line + consumed;
+        if (strcmp(name, "scroll") == 0 || strcmp(name, "cursor") == 0) {
+            event.type = (name[0] == 's') ? INPUT_EVENT_SCROLL : INPUT_EVENT_CURSOR_POS;
+            ok = sscanf(args, "%lf %lf", &event.x, &event.y) == 2;
+        } else if (strcmp(name, "button") == 0) {
+            event.type = INPUT_EVENT_MOUSE_BUTTON;
+            ok = sscanf(args, "%" SCNd32 " %" SCNd32 " %" SCNd32, &event.button, &event.action, &event.mods) == 3;
+        } else {
+            ok = false;
+        }
+
+        if (script_length == capacity) {
+            capacity = capacity ? 2 * capacity : 256;
+            script = realloc(script, capacity * sizeof(input_event_t));
+        }
+        script[script_length++] = event;
+    }
+    fclose(f);
+
+    if (!ok) {
+        free(script);
+        script = NULL;
+        script_length = 0;
+        return false;
+    }
+    *out_camera = camera;
+    replaying = true;
+    replay_fast = fast;
+    active = true;
+    return true;
+}
+
+bool input_replaying() {
+    return replaying;
+}
+
+bool input_replay_finished() {
+    return replaying && script_next == script_length && num_unshown == 0;
+}
+
+double input_replay_pump(GLFWwindow* window) {
+    if (!replaying) {
+        return -1.;
+    }
+    if (!replay_started) {
+        start_time = glfwGetTime();
+        replay_started = true;
+    }
+
+    while (script_next < script_length) {
+        const input_event_t* event = &script[script_next];
+        if (replay_fast) {
+            // the last one has to be on screen first
+            if (num_unshown > 0) {
+                return 0.;
+            }
+        } else {
+            double wait = event->time - (glfwGetTime() - start_time);
+            if (wait > 0.) {
+                return wait;
+            }
+        }
+
+        script_next++;
+        switch (event->type) {
+        case INPUT_EVENT_SCROLL:
+            scroll_callback(window, event->x, event->y);
+            break;
+        case INPUT_EVENT_CURSOR_POS:
+            cursor_pos_callback(window, event->x, event->y);
+            break;
+        case INPUT_EVENT_MOUSE_BUTTON:
+            mouse_button_callback(window, event->button, event->action, event->mods);
+            break;
+        }
+    }
+    return (num_unshown > 0) ? 0. : -1.;
+}
+
+void input_event_handled(const input_event_t* event) {
+    if (!active) {
+        return;
+    }
+    double time = glfwGetTime() - start_time;
+
+    if (record_file) {
+        fprintf(record_file, "%.6f %s ", time, event_name(event->type));
+        if (event->type == INPUT_EVENT_MOUSE_BUTTON) {
+            fprintf(record_file, "%" PRId32 " %" PRId32 " %" PRId32 "\n", event->button, event->action, event->mods);
+        } else {
+            fprintf(record_file, "%a %a\n", event->x, event->y);
+        }
+    }
+
+    if (num_handled == handled_capacity) {
+        handled_capacity = handled_capacity ? 2 * handled_capacity : 256;
+        handled = realloc(handled, handled_capacity * sizeof(handled_event_t));
+    }
+    // a cursor move without a drag changes nothing on screen
+    bool needs_frame = view_dirty || palette_dirty;
+    handled[num_handled++] = (handled_event_t) {
+        .type = event->type,
+        .time = time,
+        .latency = needs_frame ? NAN : -1.,
+    };
+    num_unshown += needs_frame;
+}
+
+void input_frame_presented() {
+    if (!active || num_unshown == 0) {
+        return;
+    }
+    double time = glfwGetTime() - start_time;
+    for (uint32_t i = first_unshown; i < num_handled; i++) {
+        if (isnan(handled[i].latency)) {
+            handled[i].latency = time - handled[i].time;
+        }
+    }
+    first_unshown = num_handled;
+    num_unshown = 0;
+}
+
+void input_report(FILE* out) {
+    if (!active) {
+        return;
+    }
+
+    fprintf(out, "event,time_s,type,latency_ms\n");
+    double* latencies = malloc((num_handled ? num_handled : 1) * sizeof(double));
+    uint32_t num_latencies = 0;
+    for (uint32_t i = 0; i < num_handled; i++) {
+        const handled_event_t* event = &handled[i];
+        // no latency: needed no frame, or the window closed first
+        if (event->latency >= 0.) {
+            fprintf(out, "%" PRIu32 ",%.6f,%s,%.3f\n", i, event->time, event_name(event->type), event->latency * 1e3);
+            latencies[num_latencies++] = event->latency;
+        } else {
+            fprintf(out, "%" PRIu32 ",%.6f,%s,\n", i, event->time, event_name(event->type));
+        }
+    }
+
+    if (num_latencies > 0) {
+        qsort(latencies, num_latencies, sizeof(double), compare_double);
+        fprintf(
+            out, "# %" PRIu32 " events, %" PRIu32 " needed a frame: input to present median %.3f ms, p95 %.3f ms, p99 %.3f ms, max %.3f ms\n",
+            num_handled, num_latencies,
+            latencies[num_latencies / 2] * 1e3,
+            latencies[(uint32_t) ceil(.95 * num_latencies) - 1] * 1e3,
+            latencies[(uint32_t) ceil(.99 * num_latencies) - 1] * 1e3,
+            latencies[num_latencies - 1] * 1e3
+        );
+    } else {
+        fprintf(out, "# %" PRIu32 " events, none needed a frame\n", num_handled);
+    }
+    free(latencies);
+
+    if (record_file) {
+        fclose(record_file);
+        record_file = NULL;
+    }
+    free(script);
+    script = NULL;
+    free(handled);
+    handled = NULL;
+    num_handled = handled_capacity = first_unshown = num_unshown = 0;
+    replaying = false;
+    active = false;
+}
@@ -0,0 +1,359 @@
+#include <stdbool.h>
+#include <string.h>
+#include <inttypes.h>
+#include <float.h>
+#include <math.h>
+
+#include <kernels.h>
+#include <mandelbrot.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#   define HAVE_X86 1
+#   include <immintrin.h>
+#else
+#   define HAVE_X86 0
+#endif
+
+// widest vector below; the SIMD kernels stage partial rows through this
+#define MAX_LANES 16
+
+static const char* isa_names[ISA_COUNT] = {
+    [ISA_AUTO] = "auto",
+    [ISA_SCALAR] = "scalar",
+    [ISA_SSE2] = "sse2",
+    [ISA_AVX2] = "avx2",
+    [ISA_AVX512] = "avx512",
+};
+
+static const uint32_t isa_lane_counts[ISA_COUNT] = {
+    [ISA_AUTO] = 0,
+    [ISA_SCALAR] = 1,
+    [ISA_SSE2] = 4,
+    [ISA_AVX2] = 8,
+    [ISA_AVX512] = 16,
+};
+
+static void escape_row_scalar(double cx0, double dx, double cy, uint32_t count, uint32_t max_iter, double period_eps, uint32_t* out_iter) {
+    for (uint32_t k = 0; k < count; k++) {
+        out_iter[k] = mandelbrot_iterate_periodic(cx0 + k * dx, cy, max_iter, period_eps);
+    }
+}
+
+static void escape_column_scalar(double cx, double cy0, double dy, uint32_t count, uint32_t max_iter, double period_eps, uint32_t* out_iter) {
+    for (uint32_t k = 0; k < count; k++) {
+        out_iter[k] = mandelbrot_iterate_periodic(cx, cy0 + k * dy, max_iter, period_eps);
+    }
+}
+
+#if HAVE_X86
+
+// every SIMD kernel follows the same shape as the loop in main.frag: a lane
+// stops counting the first time |z|^2 > 4, and the vector stops iterating
+// once no lane is counting any more. with period_eps2 > 0, a lane whose z
+// comes back within sqrt(period_eps2) of the z saved at the last power of
+// two iteration has settled into a cycle (brent), stops too and counts as
+// interior (see mandelbrot_iterate_periodic())
+
+__attribute__((target("sse2")))
+static void escape_vec_sse2(const float* cx_in, const float* cy_in, uint32_t max_iter, float period_eps2, uint32_t* out_iter) {
+    __m128 cx = _mm_loadu_ps(cx_in);
+    __m128 cy = _mm_loadu_ps(cy_in);
+    __m128 four = _mm_set1_ps(4.f);
+    __m128 zx = _mm_setzero_ps();
+    __m128 zy = _mm_setzero_ps();
+    __m128 active = _mm_castsi128_ps(_mm_set1_epi32(-1));
+    __m128i iter = _mm_setzero_si128();
+
+    __m128 eps2 = _mm_set1_ps(period_eps2);
+    __m128 saved_x = _mm_setzero_ps();
+    __m128 saved_y = _mm_setzero_ps();
+    __m128 periodic = _mm_setzero_ps();
+    uint32_t next_save = 1;
+
+    for (uint32_t i = 0; i < max_iter; i++) {
+        __m128 zx2 = _mm_mul_ps(zx, zx);
+        __m128 zy2 = _mm_mul_ps(zy, zy);
+
+        active = _mm_and_ps(active, _mm_cmple_ps(_mm_add_ps(zx2, zy2), four));
+        if (_mm_movemask_ps(active) == 0) { break; }
+
+        // active lanes are all ones, i.e. -1
+        iter = _mm_sub_epi32(iter, _mm_castps_si128(active));
+
+        __m128 zxzy = _mm_mul_ps(zx, zy);
+        zy = _mm_add_ps(_mm_add_ps(zxzy, zxzy), cy);
+        zx = _mm_add_ps(_mm_sub_ps(zx2, zy2), cx);
+
+        if (period_eps2 > 0.f) {
+            __m128 ex = _mm_sub_ps(zx, saved_x);
+            __m128 ey = _mm_sub_ps(zy, saved_y);
+            __m128 cycled = _mm_and_ps(active, _mm_cmplt_ps(_mm_add_ps(_mm_mul_ps(ex, ex), _mm_mul_ps(ey, ey)), eps2));
+            periodic = _mm_or_ps(periodic, cycled);
+            active = _mm_andnot_ps(cycled, active);
+            if (i + 1 == next_save) {
+                saved_x = zx;
+                saved_y = zy;
+                next_save *= 2;
+            }
+        }
+    }
+
+    __m128i periodic_i = _mm_castps_si128(periodic);
+    iter = _mm_or_si128(_mm_andnot_si128(periodic_i, iter), _mm_and_si128(periodic_i, _mm_set1_epi32((int32_t) max_iter)));
+    _mm_storeu_si128((__m128i*) out_iter, iter);
+}
+
+__attribute__((target("avx2,fma")))
+static void escape_vec_avx2(const float* cx_in, const float* cy_in, uint32_t max_iter, float period_eps2, uint32_t* out_iter) {
+    __m256 cx = _mm256_loadu_ps(cx_in);
+    __m256 cy = _mm256_loadu_ps(cy_in);
+    __m256 four = _mm256_set1_ps(4.f);
+    __m256 zx = _mm256_setzero_ps();
+    __m256 zy = _mm256_setzero_ps();
+    __m256 active = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+    __m256i iter = _mm256_setzero_si256();
+
+    __m256 eps2 = _mm256_set1_ps(period_eps2);
+    __m256 saved_x = _mm256_setzero_ps();
+    __m256 saved_y = _mm256_setzero_ps();
+    __m256 periodic = _mm256_setzero_ps();
+    uint32_t next_save = 1;
+
+    for (uint32_t i = 0; i < max_iter; i++) {
+        __m256 zx2 = _mm256_mul_ps(zx, zx);
+        __m256 zy2 = _mm256_mul_ps(zy, zy);
+
+        active = _mm256_and_ps(active, _mm256_cmp_ps(_mm256_add_ps(zx2, zy2), four, _CMP_LE_OQ));
+        if (_mm256_movemask_ps(active) == 0) { break; }
+
+        iter = _mm256_sub_epi32(iter, _mm256_castps_si256(active));
+
+        __m256 zxzy = _mm256_mul_ps(zx, zy);
+        zy = _mm256_add_ps(_mm256_add_ps(zxzy, zxzy), cy);
+        zx = _mm256_add_ps(_mm256_sub_ps(zx2, zy2), cx);
+
+        if (period_eps2 > 0.f) {
+            __m256 ex = _mm256_sub_ps(zx, saved_x);
+            __m256 ey = _mm256_sub_ps(zy, saved_y);
+            __m256 dist2 = _mm256_fmadd_ps(ex, ex, _mm256_mul_ps(ey, ey));
+            __m256 cycled = _mm256_and_ps(active, _mm256_cmp_ps(dist2, eps2, _CMP_LT_OQ));
+            periodic = _mm256_or_ps(periodic, cycled);
+            active = _mm256_andnot_ps(cycled, active);
+            if (i + 1 == next_save) {
+                saved_x = zx;
+                saved_y = zy;
+                next_save *= 2;
+            }
+        }
+    }
+
+    iter = _mm256_blendv_epi8(iter, _mm256_set1_epi32((int32_t) max_iter), _mm256_castps_si256(periodic));
+    _mm256_storeu_si256((__m256i*) out_iter, iter);
+}
+
+__attribute__((target("avx512f")))
+static void escape_vec_avx512(const float* cx_in, const float* cy_in, uint32_t max_iter, float period_eps2, uint32_t* out_iter) {
+    __m512 cx = _mm512_loadu_ps(cx_in);
+    __m512 cy = _mm512_loadu_ps(cy_in);
+    __m512 four = _mm512_set1_ps(4.f);
+    __m512 zx = _mm512_setzero_ps();
+    __m512 zy = _mm512_setzero_ps();
+    __m512i one = _mm512_set1_epi32(1);
+    __m512i iter = _mm512_setzero_si512();
+    __mmask16 active = 0xFFFF;
+
+    __m512 eps2 = _mm512_set1_ps(period_eps2);
+    __m512 saved_x = _mm512_setzero_ps();
+    __m512 saved_y = _mm512_setzero_ps();
+    __mmask16 periodic = 0;
+    uint32_t next_save = 1;
+
+    for (uint32_t i = 0; i < max_iter; i++) {
+        __m512 zx2 = _mm512_mul_ps(zx, zx);
+        __m512 zy2 = _mm512_mul_ps(zy, zy);
+
+        active = _mm512_mask_cmp_ps_mask(active, _mm512_add_ps(zx2, zy2), four, _CMP_LE_OQ);
+        if (active == 0) { break; }
+
+        iter = _mm512_mask_add_epi32(iter, active, iter, one);
+
+        __m512 zxzy = _mm512_mul_ps(zx, zy);
+        zy = _mm512_add_ps(_mm512_add_ps(zxzy, zxzy), cy);
+        zx = _mm512_add_ps(_mm512_sub_ps(zx2, zy2), cx);
+
+        if (period_eps2 > 0.f) {
+            __m512 ex = _mm512_sub_ps(zx, saved_x);
+            __m512 ey = _mm512_sub_ps(zy, saved_y);
+            __m512 dist2 = _mm512_fmadd_ps(ex, ex, _mm512_mul_ps(ey, ey));
+            __mmask16 cycled = _mm512_mask_cmp_ps_mask(active, dist2, eps2, _CMP_LT_OQ);
+            periodic |= cycled;
+            active &= ~cycled;
+            if (i + 1 == next_save) {
+                saved_x = zx;
+                saved_y = zy;
+                next_save *= 2;
+            }
+        }
+    }
+
+    iter = _mm512_mask_mov_epi32(iter, periodic, _mm512_set1_epi32((int32_t) max_iter));
+    _mm512_storeu_si512(out_iter, iter);
+}
+
+typedef void (*escape_vec_fn)(const float* cx, const float* cy, uint32_t max_iter, float period_eps2, uint32_t* out_iter);
+
+// feeds count points, (x0 + k * dx, y0 + k * dy), through a vector kernel;
+// the ragged end is padded with copies of the last point so it can't hold
+// the vector up
+static inline void escape_line_vec(escape_vec_fn vec, uint32_t lanes, double x0, double dx, double y0, double dy, uint32_t count, uint32_t max_iter, double period_eps, uint32_t* out_iter) {
+    float period_eps2 = (float) (period_eps * period_eps);
+    float cx[MAX_LANES];
+    float cy[MAX_LANES];
+    uint32_t iter[MAX_LANES];
+
+    for (uint32_t k = 0; k < count; k += lanes) {
+        uint32_t n = (count - k < lanes) ? count - k : lanes;
+        for (uint32_t l = 0; l < lanes; l++) {
+            uint32_t lane_k = k + ((l < n) ? l : n - 1);
+            cx[l] = (float) (x0 + lane_k * dx);
+            cy[l] = (float) (y0 + lane_k * dy);
+        }
+
+        if (n == lanes) {
+            vec(cx, cy, max_iter, period_eps2, &out_iter[k]);
+        } else {
+            vec(cx, cy, max_iter, period_eps2, iter);
+            memcpy(&out_iter[k], iter, n * sizeof(uint32_t));
+        }
+    }
+}
+
+static void escape_row_sse2(double cx0, double dx, double cy, uint32_t count, uint32_t max_iter, double period_eps, uint32_t* out_iter) {
+    escape_line_vec(escape_vec_sse2, 4, cx0, dx, cy, 0., count, max_iter, period_eps, out_iter);
+}
+
+static void escape_row_avx2(double cx0, double dx, double cy, uint32_t count, uint32_t max_iter, double period_eps, uint32_t* out_iter) {
+    escape_line_vec(escape_vec_avx2, 8, cx0, dx, cy, 0., count, max_iter, period_eps, out_iter);
+}
+
+static void escape_row_avx512(double cx0, double dx, double cy, uint32_t count, uint32_t max_iter, double period_eps, uint32_t* out_iter) {
+    escape_line_vec(escape_vec_avx512, 16, cx0, dx, cy, 0., count, max_iter, period_eps, out_iter);
+}
+
+static void escape_column_sse2(double cx, double cy0, double dy, uint32_t count, uint32_t max_iter, double period_eps, uint32_t* out_iter) {
+    escape_line_vec(escape_vec_sse2, 4, cx, 0., cy0, dy, count, max_iter, period_eps, out_iter);
+}
+
+static void escape_column_avx2(double cx, double cy0, double dy, uint32_t count, uint32_t max_iter, double period_eps, uint32_t* out_iter) {
+    escape_line_vec(escape_vec_avx2, 8, cx, 0., cy0, dy, count, max_iter, period_eps, out_iter);
+}
+
+static void escape_column_avx512(double cx, double cy0, double dy, uint32_t count, uint32_t max_iter, double period_eps, uint32_t* out_iter) {
+    escape_line_vec(escape_vec_avx512, 16, cx, 0., cy0, dy, count, max_iter, period_eps, out_iter);
+}
+
+#endif // HAVE_X86
+
+const char* isa_name(isa_t isa) {
+    return (isa < ISA_COUNT) ? isa_names[isa] : "unknown";
+}
+
+bool isa_from_name(const char* name, isa_t* out_isa) {
+    for (isa_t isa = 0; isa < ISA_COUNT; isa++) {
+        if (strcmp(name, isa_names[isa]) == 0) {
+            *out_isa = isa;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool isa_supported(isa_t isa) {
+    switch (isa) {
+    case ISA_SCALAR:
+        return true;
+#if HAVE_X86
+    // __builtin_cpu_supports() reads the CPUID bits cached by libgcc at startup
+    case ISA_SSE2:
+        return __builtin_cpu_supports("sse2");
+    case ISA_AVX2:
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    case ISA_AVX512:
+        return __builtin_cpu_supports("avx512f");
+#endif
+    default:
+        return false;
+    }
+}
+
+isa_t isa_best_supported() {
+    for (isa_t isa = ISA_COUNT - 1; isa > ISA_SCALAR; isa--) {
+        if (isa_supported(isa)) {
+            return isa;
+        }
+    }
+    return ISA_SCALAR;
+}
+
+isa_t isa_resolve(isa_t isa) {
+    if (isa == ISA_AUTO || isa >= ISA_COUNT) {
+        return isa_best_supported();
+    }
+    while (isa > ISA_SCALAR && !isa_supported(isa)) {
+        isa--;
+    }
+    return isa;
+}
+
+uint32_t isa_lanes(isa_t isa) {
+    return isa_lane_counts[isa_resolve(isa)];
+}
+
+escape_row_fn kernel_for_isa(isa_t isa) {
+    switch (isa_resolve(isa)) {
+#if HAVE_X86
+    case ISA_SSE2:
+        return escape_row_sse2;
+    case ISA_AVX2:
+        return escape_row_avx2;
+    case ISA_AVX512:
+        return escape_row_avx512;
+#endif
+    default:
+        return escape_row_scalar;
+    }
+}
+
+escape_column_fn column_kernel_for_isa(isa_t isa) {
+    switch (isa_resolve(isa)) {
+#if HAVE_X86
+    case ISA_SSE2:
+        return escape_column_sse2;
+    case ISA_AVX2:
+        return escape_column_avx2;
+    case ISA_AVX512:
+        return escape_column_avx512;
+#endif
+    default:
+        return escape_column_scalar;
+    }
+}
+
+bool kernel_precision_ok(const view_t* view, double epsilon) {
+    double scale = (view->width < view->height) ? view->width : view->height;
+    double larger_side = (view->width > view->height) ? view->width : view->height;
+
+    double pixel_size = view_pixel_size(view);
+    double max_coord = fmax(fabs(view->pan_x), fabs(view->pan_y)) + 2. * view->zoom * larger_side / scale;
+
+    // a few ulps of headroom so the z^2 + c rounding doesn't merge pixels
+    return pixel_size > max_coord * epsilon * 4.;
+}
+
+bool kernel_float_precision_ok(const view_t* view) {
+    return kernel_precision_ok(view, FLT_EPSILON);
+}
+
+bool kernel_double_precision_ok(const view_t* view) {
+    return kernel_precision_ok(view, DBL_EPSILON);
+}
@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <stdbool.h>
 #include <inttypes.h>
@@ -10,24 +11,106 @@
 #include <GLFW/glfw3.h>
 
 #include <callbacks.h>
+#include <camera.h>
+#include <gl_escape_compute.h>
+#include <gl_iter_buffer.h>
+#include <gl_profiler.h>
+#include <gl_reference.h>
+#include <headless.h>
+#include <input_replay.h>
+#include <kernels.h>
+#include <mandelbrot.h>
+#include <options.h>
+#include <reference_cache.h>
+#include <shader_policy.h>
+#include <trace.h>
+
+// progressive refinement's first pass does every 8th pixel each way
+#define PROGRESSIVE_COARSEST_STRIDE 8
+// seconds between looks at a reference orbit that's still being computed
+#define REFERENCE_POLL_INTERVAL .05
 
 float window_width = 1000.f;
 float window_height = 1000.f;
-float zoom = 1.f;
-float x_off;
-float y_off;
-
-uint32_t create_shader_program();
-GLFWwindow* init_window();
+// pan and zoom, moved from the mouse callbacks
+camera_t camera;
+
+// colorize pass state, changed from key_callback
+uint32_t palette_index;
+float exposure;
+uint8_t smooth_coloring;
+// frame profiler overlay, toggled from key_callback
+uint8_t show_profiler;
+
+extern uint8_t view_dirty;      // src/callbacks.c
+extern uint8_t palette_dirty;
+
+// uniform locations in one variant of main.frag
+typedef struct {
+    uint32_t resolution, zoom, pan, max_iter;
+    uint32_t pan_df, zoom_df;
+    uint32_t perturb, ref_len, ref_c, ref_offset;
+    uint32_t bla_levels, bla_offset, bla_count;
+    uint32_t stride, refine, bulb_check, period_eps2;
+    // shader/escape.comp only
+    uint32_t rect, first_pass, fill_escaped;
+} escape_uniforms_t;
+
+uint32_t compile_with_defines(GLenum type, const char* what, const unsigned char* source, size_t length, const char* defines, const unsigned char* tail, size_t tail_length);
+uint32_t link_program(uint32_t* shaders, uint32_t num_shaders);
+uint32_t create_shader_program(const char* vert_path, const char* frag_path, const char* frag_defines);
+uint32_t create_compute_program(const char* frag_path, const char* comp_path, const char* defines);
+bool gl_has_fp64();
+void get_escape_uniforms(uint32_t program, escape_uniforms_t* out);
+void split_double_float(double hi, double lo, float* out_hi, float* out_lo);
+GLFWwindow* init_window(bool user_input);
 void process_input(GLFWwindow* window);
-void cleanup(GLFWwindow* window, uint32_t shader_program);
+void cleanup(GLFWwindow* window);
 bool read_file(const char* filename, unsigned char **out_buffer, size_t* out_length);
 
-int32_t main() {
-    x_off = window_width / 2.f;
-    y_off = window_height / 2.f;
+int32_t main(int argc, char** argv) {
+    options_t opts;
+    options_parse(&opts, argc, argv);
+
+    if (opts.trace && !trace_start(opts.trace)) {
+        fprintf(stderr, "Couldn't create %s\n", opts.trace);
+        return -1;
+    }
+
+    if (opts.backend == BACKEND_CPU) {
+        return headless_run(&opts);
+    }
+
+    window_width = opts.width;
+    window_height = opts.height;
+    palette_index = opts.palette;
+    exposure = opts.exposure;
+    smooth_coloring = opts.smooth;
+    show_profiler = opts.profile;
 
-    GLFWwindow* window = init_window();
+    camera_init(&camera, opts.pan_x, opts.pan_y, opts.zoom);
+    camera_set_center_decimal(&camera, opts.pan_re, opts.pan_im);
+
+    if (opts.record && opts.replay) {
+        fprintf(stderr, "--record and --replay don't go together\n");
+        return -1;
+    }
+    // a replay starts from the window and view it was recorded with
+    if (opts.replay) {
+        uint32_t width, height;
+        if (!input_replay_load(opts.replay, opts.replay_fast, &width, &height, &camera)) {
+            fprintf(stderr, "Couldn't read %s\n", opts.replay);
+            return -1;
+        }
+        window_width = width;
+        window_height = height;
+    }
+
+    GLFWwindow* window = init_window(!opts.replay);
+    if (opts.record && !input_record_start(opts.record, (uint32_t) window_width, (uint32_t) window_height, &camera)) {
+        fprintf(stderr, "Couldn't create %s\n", opts.record);
+        return -1;
+    }
 
     // static float vertices[] = {
     //     -1.f,  1.f, // 0: top-left pos
@@ -99,19 +182,95 @@ int32_t main() {
         glEnableVertexAttribArray(1);
     }
 
-    uint32_t shader_program;
-    uint32_t uni_loc_resolution, uni_loc_zoom, uni_loc_pan;
+    // which variants of main.frag the policy may pick from; forcing one
+    // leaves it the only choice
+    bool has_fp64 = gl_has_fp64();
+    bool available[SHADER_VARIANT_COUNT] = { false };
+    switch (opts.shader_precision) {
+        case SHADER_PRECISION_AUTO:
+            available[SHADER_VARIANT_FLOAT] = true;
+            available[SHADER_VARIANT_DOUBLE_FLOAT] = true;
+            available[SHADER_VARIANT_FP64] = has_fp64;
+            break;
+        case SHADER_PRECISION_FLOAT:
+            available[SHADER_VARIANT_FLOAT] = true;
+            break;
+        case SHADER_PRECISION_DOUBLE_FLOAT:
+            available[SHADER_VARIANT_DOUBLE_FLOAT] = true;
+            break;
+        case SHADER_PRECISION_FP64:
+            if (!has_fp64) {
+                fprintf(stderr, "This context has no fp64, falling back to float\n");
+            }
+            available[has_fp64 ? SHADER_VARIANT_FP64 : SHADER_VARIANT_FLOAT] = true;
+            break;
+    }
+    shader_policy_t policy;
+    shader_policy_init(&policy, available);
+
+    static const char* variant_defines[SHADER_VARIANT_COUNT] = {
+        [SHADER_VARIANT_FLOAT] = "",
+        [SHADER_VARIANT_DOUBLE_FLOAT] = "#define PRECISION_DOUBLE_FLOAT\n",
+        [SHADER_VARIANT_FP64] = "#define PRECISION_FP64\n",
+    };
+
+    uint32_t escape_programs[SHADER_VARIANT_COUNT] = { 0 };
+    escape_uniforms_t escape_uniforms[SHADER_VARIANT_COUNT];
+    uint32_t colorize_program;
+    uint32_t uni_loc_iterations, uni_loc_color_max_iter, uni_loc_color_start, uni_loc_color_end;
+    uint32_t uni_loc_exposure, uni_loc_smooth, uni_loc_color_stride;
 
     // shader
     {
-        shader_program = create_shader_program();
-        glUseProgram(shader_program);
+        for (uint32_t v = 0; v < SHADER_VARIANT_COUNT; v++) {
+            if (available[v]) {
+                escape_programs[v] = (opts.escape == ESCAPE_COMPUTE)
+                    ? create_compute_program("shader/main.frag", "shader/escape.comp", variant_defines[v])
+                    : create_shader_program("shader/main.vert", "shader/main.frag", variant_defines[v]);
+                get_escape_uniforms(escape_programs[v], &escape_uniforms[v]);
+            }
+        }
+        colorize_program = create_shader_program("shader/main.vert", "shader/colorize.frag", "");
+
+        uni_loc_iterations = glGetUniformLocation(colorize_program, "u_iterations");
+        uni_loc_color_max_iter = glGetUniformLocation(colorize_program, "u_max_iter");
+        uni_loc_color_start = glGetUniformLocation(colorize_program, "u_color_start");
+        uni_loc_color_end = glGetUniformLocation(colorize_program, "u_color_end");
+        uni_loc_exposure = glGetUniformLocation(colorize_program, "u_exposure");
+        uni_loc_smooth = glGetUniformLocation(colorize_program, "u_smooth");
+        uni_loc_color_stride = glGetUniformLocation(colorize_program, "u_stride");
+    }
 
-        uni_loc_resolution = glGetUniformLocation(shader_program, "u_resolution");
-        uni_loc_zoom = glGetUniformLocation(shader_program, "u_zoom");
-        uni_loc_pan = glGetUniformLocation(shader_program, "u_pan");
+    // per-stage CPU and GPU times of the render block below
+    gl_profiler_t profiler;
+    if (!gl_profiler_init(&profiler, opts.profile_csv, create_shader_program("shader/main.vert", "shader/profiler.frag", ""))) {
+        fprintf(stderr, "Couldn't create %s\n", opts.profile_csv);
+        return -1;
     }
 
+    // tile queues of the compute escape pass
+    gl_escape_compute_t escape_compute;
+    if (opts.escape == ESCAPE_COMPUTE) {
+        gl_escape_compute_init(&escape_compute);
+    }
+
+    // escape counts live here between frames, so recoloring doesn't re-iterate
+    gl_iter_buffer_t iter_buffer;
+    gl_iter_buffer_init(&iter_buffer, (uint32_t) window_width, (uint32_t) window_height);
+    // max_iter of what's in iter_buffer
+    uint32_t iter_buffer_max_iter = 0;
+    // only every iter_buffer_stride-th pixel of iter_buffer is done yet
+    uint32_t iter_buffer_stride = 1;
+    // stride of the refinement pass to run next, 0 once everything is done.
+    // any view change starts over from the coarsest pass
+    uint32_t refine_stride = 0;
+
+    // deep zoom reference orbit, only used once float runs out; the ones the
+    // view leaves behind are kept for when it comes back
+    reference_cache_t* ref_cache = reference_cache_create((size_t) opts.ref_cache_mb << 20, opts.ref_cache_dir);
+    gl_reference_t glref;
+    gl_reference_init(&glref, ref_cache);
+
     uint64_t frame_no = 0;
     double start_time = glfwGetTime();
     double last_frame_time = start_time;
@@ -119,29 +278,279 @@ int32_t main() {
     double report_timer = report_every;
     uint64_t num_frames_since_report = 0;
 
+    // whether the last frame went through glref, for the glitch count
+    bool perturbed = false;
+    // main.frag variant the last escape pass ran
+    shader_variant_t variant = SHADER_VARIANT_FLOAT;
+    // GPU time of an escape pass, fed to the policy once it's ready; only
+    // one in flight, so reading it back never stalls
+    uint32_t timer_query;
+    glGenQueries(1, &timer_query);
+    bool timer_pending = false;
+    shader_variant_t timer_variant = SHADER_VARIANT_FLOAT;
+    double timer_pixels = 0.;
+    uint32_t timer_max_iter = 0;
+    // the view iter_buffer holds, so a pan only renders what it exposed
+    view_t last_view;
+    bool have_last_view = false;
+
     glClearColor(0.1f, 0.1f, 0.15f, 0.f);
     while (!glfwWindowShouldClose(window)) {
         process_input(window);
+        double replay_wait = input_replay_pump(window);
+        if (input_replay_finished()) {
+            break;
+        }
+
+        // an orbit is on its way: look in on it a few times a second
+        // instead of spinning
+        if (gl_reference_computing(&glref, NULL)) {
+            trace_begin("wait for orbit");
+            glfwWaitEventsTimeout(replay_wait >= 0. ? fmin(replay_wait, REFERENCE_POLL_INTERVAL) : REFERENCE_POLL_INTERVAL);
+            trace_end();
+        }
+
+        // nothing changed: sleep until an event arrives instead of redrawing
+        // the same frame
+        if (opts.redraw == REDRAW_ON_CHANGE && !view_dirty && !palette_dirty && refine_stride == 0) {
+            trace_begin("wait for events");
+            if (input_replaying()) {
+                // not past the next replayed event
+                glfwWaitEventsTimeout(fmax(replay_wait, 0.));
+            } else {
+                glfwWaitEvents();
+            }
+            trace_end();
+            continue;
+        }
+        if (show_profiler != profiler.show) {
+            gl_profiler_show(&profiler, show_profiler);
+        }
+        trace_begin("frame");
+        gl_profiler_frame_begin(&profiler);
+
+        // a palette change alone only needs the colorize pass
+        bool view_changed = view_dirty;
+        bool iterate = view_changed || refine_stride > 0 || opts.redraw == REDRAW_ALWAYS;
+        view_dirty = false;
+        palette_dirty = false;
+
+        // what the escape pass has to cover; the whole window unless the
+        // last frame can be shifted into place
+        pixel_rect_t rects[2] = { { 0, 0, (uint32_t) window_width, (uint32_t) window_height } };
+        uint32_t num_rects = 1;
+        int32_t shift_x = 0, shift_y = 0;
+        // every stride-th pixel; refine = the previous pass did every other one of those
+        uint32_t stride = 1;
+        bool refine = false;
+
+        // same view the shader sees, for the max_iter and precision decisions
+        view_t view = camera_view(&camera, (uint32_t) window_width, (uint32_t) window_height, opts.max_iter);
+        const escape_uniforms_t* uni = &escape_uniforms[variant];
+        bool perturb = false;
+        bool reference_changed = false;
+
+        // pick the variant, and make sure a perturbed frame has its orbit
+        if (iterate) {
+            gl_profiler_begin(&profiler, PROFILER_STAGE_PREPARE);
+
+            if (timer_pending) {
+                int32_t ready = 0;
+                glGetQueryObjectiv(timer_query, GL_QUERY_RESULT_AVAILABLE, &ready);
+                if (ready) {
+                    uint64_t elapsed_ns = 0;
+                    glGetQueryObjectui64v(timer_query, GL_QUERY_RESULT, &elapsed_ns);
+                    shader_policy_record(&policy, timer_variant, elapsed_ns * 1e-9, timer_pixels, timer_max_iter);
+                    timer_pending = false;
+                }
+            }
+
+            bool precise;
+            variant = shader_policy_choose(&policy, &view, &precise);
+            uni = &escape_uniforms[variant];
+
+            perturb = (opts.perturb == PERTURB_ON) || (opts.perturb == PERTURB_AUTO && !precise);
+            if (perturb) {
+                reference_changed = gl_reference_update(&glref, &view);
+                // no orbit to iterate against yet: keep the last frame up
+                // and look again next time round
+                if (gl_reference_computing(&glref, NULL)) {
+                    view_dirty = true;
+                    iterate = false;
+                }
+            }
+            gl_profiler_end(&profiler, PROFILER_STAGE_PREPARE);
+        }
 
         // update uniformss
-        {
+        if (iterate) {
+            gl_profiler_begin(&profiler, PROFILER_STAGE_UNIFORMS);
             float scale_factor = (window_width < window_height) ? window_width : window_height;
+            glUseProgram(escape_programs[variant]);
+
+            glUniform2f(uni->resolution, scale_factor, scale_factor);
+            if (variant == SHADER_VARIANT_FP64) {
+                glUniform2d(uni->pan, view.pan_x, view.pan_y);
+                glUniform1d(uni->zoom, view.zoom);
+            } else {
+                glUniform2f(uni->pan, (float) view.pan_x, (float) view.pan_y);
+                glUniform1f(uni->zoom, (float) view.zoom);
+            }
+            if (variant == SHADER_VARIANT_DOUBLE_FLOAT) {
+                float pan_df[4], zoom_df[2];
+                split_double_float(view.pan_x, view.pan_x_lo, &pan_df[0], &pan_df[1]);
+                split_double_float(view.pan_y, view.pan_y_lo, &pan_df[2], &pan_df[3]);
+                split_double_float(view.zoom, 0., &zoom_df[0], &zoom_df[1]);
+                glUniform4fv(uni->pan_df, 1, pan_df);
+                glUniform2fv(uni->zoom_df, 1, zoom_df);
+            }
+            glUniform1i(uni->bulb_check, opts.bulb_check);
+            if (opts.escape == ESCAPE_COMPUTE) {
+                glUniform1i(uni->fill_escaped, opts.subdivide == SUBDIVIDE_ON);
+            }
+
+            glUniform1ui(uni->max_iter, view_max_iter(&view));
+            double period_eps = opts.periodicity ? opts.period_tolerance * view_pixel_size(&view) : 0.;
+            glUniform1f(uni->period_eps2, (float) (period_eps * period_eps));
+            iter_buffer_max_iter = view_max_iter(&view);
+
+            glUniform1i(uni->perturb, perturb);
+            reference_changed |= perturb != perturbed;
+            perturbed = perturb;
+            if (perturb) {
+                glUniform1ui(uni->ref_len, glref.ref->length);
+                glUniform2f(uni->ref_c, (float) glref.ref->c_re_d, (float) glref.ref->c_im_d);
+                double ref_dx, ref_dy;
+                gl_reference_offset(&glref, &view, &ref_dx, &ref_dy);
+                glUniform2f(uni->ref_offset, (float) ref_dx, (float) ref_dy);
+
+                gl_reference_reset_glitched(&glref);
+
+                glUniform1ui(uni->bla_levels, opts.bla ? glref.bla->num_levels : 0);
+                glUniform1uiv(uni->bla_offset, BLA_MAX_LEVELS, glref.bla->level_offset);
+                glUniform1uiv(uni->bla_count, BLA_MAX_LEVELS, glref.bla->level_count);
+            }
 
-            glUniform2f(uni_loc_resolution, scale_factor, scale_factor);
-            glUniform2f(uni_loc_pan, x_off, y_off);
-            glUniform1f(uni_loc_zoom, (float) zoom);
+            // pixels from another reference would be fine too, but they'd
+            // glitch differently from their new neighbours
+            bool resized = gl_iter_buffer_resize(&iter_buffer, (uint32_t) window_width, (uint32_t) window_height);
+            // an unmoved view (--redraw=always) still iterates everything.
+            // a pan only exposes thin strips, so those go straight to full
+            // resolution, but only onto a finished frame
+            if (view_changed && have_last_view && !resized && !reference_changed && iter_buffer_stride == 1
+                && view_pixel_shift(&last_view, &view, &shift_x, &shift_y)
+                && (shift_x != 0 || shift_y != 0)) {
+                num_rects = view_exposed_rects(view.width, view.height, shift_x, shift_y, rects);
+                refine_stride = 0;
+            } else if (view_changed && opts.progressive) {
+                shift_x = shift_y = 0;
+                stride = PROGRESSIVE_COARSEST_STRIDE;
+                refine_stride = stride / 2;
+            } else if (refine_stride > 0) {
+                shift_x = shift_y = 0;
+                stride = refine_stride;
+                refine = true;
+                refine_stride /= 2;
+            } else {
+                shift_x = shift_y = 0;
+            }
+            last_view = view;
+            have_last_view = true;
+            iter_buffer_stride = stride;
+
+            glUniform1ui(uni->stride, stride);
+            glUniform1i(uni->refine, refine);
+            gl_profiler_end(&profiler, PROFILER_STAGE_UNIFORMS);
         }
 
         // render
         {
-            glClear(GL_COLOR_BUFFER_BIT);
-
             glBindBuffer(GL_ARRAY_BUFFER, VBO);
             glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-            // glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_BYTE, 0);
+
+            // escape pass, into the iteration buffer
+            if (iterate) {
+                gl_profiler_begin(&profiler, PROFILER_STAGE_ESCAPE);
+                if (shift_x != 0 || shift_y != 0) {
+                    gl_iter_buffer_shift(&iter_buffer, shift_x, shift_y);
+                }
+                // only the plain loop's cost tells the variants apart
+                bool timed = opts.shader_precision == SHADER_PRECISION_AUTO && !timer_pending && !perturbed;
+                if (timed) {
+                    double pixels = 0.;
+                    for (uint32_t k = 0; k < num_rects; k++) {
+                        pixels += (double) (rects[k].x1 - rects[k].x0) * (rects[k].y1 - rects[k].y0);
+                    }
+                    timer_pixels = pixels / (stride * stride) * (refine ? .75 : 1.);
+                    timer_variant = variant;
+                    timer_max_iter = iter_buffer_max_iter;
+                    glBeginQuery(GL_TIME_ELAPSED, timer_query);
+                }
+
+                gl_iter_buffer_bind(&iter_buffer);
+                if (opts.escape == ESCAPE_COMPUTE) {
+                    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+                    // grid points, stride pixels apart, rows from the bottom
+                    for (uint32_t k = 0; k < num_rects; k++) {
+                        gl_escape_compute_run(
+                            &escape_compute, uni->rect, uni->first_pass,
+                            rects[k].x0 / stride, (iter_buffer.height - rects[k].y1) / stride,
+                            (rects[k].x1 + stride - 1) / stride, (iter_buffer.height - rects[k].y0 + stride - 1) / stride
+                        );
+                    }
+                } else {
+                    glViewport(0, 0, (iter_buffer.width + stride - 1) / stride, (iter_buffer.height + stride - 1) / stride);
+                    // rects count rows from the top, the scissor from the bottom
+                    glEnable(GL_SCISSOR_TEST);
+                    for (uint32_t k = 0; k < num_rects; k++) {
+                        glScissor(rects[k].x0, iter_buffer.height - rects[k].y1, rects[k].x1 - rects[k].x0, rects[k].y1 - rects[k].y0);
+                        // glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_BYTE, 0);
+                        glDrawElements(GL_TRIANGLE_STRIP, 4, GL_UNSIGNED_BYTE, 0);
+                    }
+                    glDisable(GL_SCISSOR_TEST);
+                    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+                }
+                if (timed) {
+                    glEndQuery(GL_TIME_ELAPSED);
+                    timer_pending = true;
+                }
+                glViewport(0, 0, iter_buffer.width, iter_buffer.height);
+                glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+                gl_profiler_end(&profiler, PROFILER_STAGE_ESCAPE);
+            }
+
+            // colorize pass, to the screen
+            gl_profiler_begin(&profiler, PROFILER_STAGE_COLORIZE);
+            palette_t palette = palette_preset(palette_index);
+            glUseProgram(colorize_program);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, iter_buffer.texture[iter_buffer.current]);
+            glUniform1i(uni_loc_iterations, 0);
+            glUniform1ui(uni_loc_color_max_iter, iter_buffer_max_iter);
+            glUniform1ui(uni_loc_color_stride, iter_buffer_stride);
+            glUniform3f(uni_loc_color_start, palette.start[0] / 255.f, palette.start[1] / 255.f, palette.start[2] / 255.f);
+            glUniform3f(uni_loc_color_end, palette.end[0] / 255.f, palette.end[1] / 255.f, palette.end[2] / 255.f);
+            glUniform1f(uni_loc_exposure, exposure);
+            glUniform1i(uni_loc_smooth, smooth_coloring != 0);
+
+            glClear(GL_COLOR_BUFFER_BIT);
             glDrawElements(GL_TRIANGLE_STRIP, 4, GL_UNSIGNED_BYTE, 0);
+            gl_profiler_end(&profiler, PROFILER_STAGE_COLORIZE);
+
+            if (profiler.show) {
+                gl_profiler_begin(&profiler, PROFILER_STAGE_OVERLAY);
+                gl_profiler_draw(&profiler, (uint32_t) window_width, (uint32_t) window_height);
+                gl_profiler_end(&profiler, PROFILER_STAGE_OVERLAY);
+            }
 
+            gl_profiler_begin(&profiler, PROFILER_STAGE_SWAP);
             glfwSwapBuffers(window);
+            gl_profiler_end(&profiler, PROFILER_STAGE_SWAP);
+            gl_profiler_frame_end(&profiler);
+            // unless it's the last frame again, waiting on an orbit
+            if (!view_dirty) {
+                input_frame_presented();
+            }
         }
 
         // framerate
@@ -157,7 +566,14 @@ int32_t main() {
                 double actual_time = report_every - report_timer;
                 double fps = (double) num_frames_since_report / actual_time;
                 char* title;
-                asprintf(&title, "Mandelbrot (%.2f fps, %.10fx zoom)", fps, zoom);
+                double orbit_fraction;
+                if (gl_reference_computing(&glref, &orbit_fraction)) {
+                    asprintf(&title, "Mandelbrot (%gx zoom, computing reference orbit: %.0f%%)", camera_zoom(&camera), orbit_fraction * 100.);
+                } else if (perturbed) {
+                    asprintf(&title, "Mandelbrot (%.2f fps, %gx zoom, %" PRIu32 " glitched)", fps, camera_zoom(&camera), gl_reference_glitched(&glref));
+                } else {
+                    asprintf(&title, "Mandelbrot (%.2f fps, %gx zoom, %s)", fps, camera_zoom(&camera), shader_variant_name(variant));
+                }
                 glfwSetWindowTitle(window, title);
                 free(title);
 
@@ -166,80 +582,208 @@ int32_t main() {
             }
             last_frame_time = current_time;
         }
+        trace_end();
 
+        trace_begin("poll events");
         glfwPollEvents();
+        trace_end();
     }
 
-    cleanup(window, shader_program);
+    input_report(stdout);
+    glDeleteQueries(1, &timer_query);
+    gl_profiler_destroy(&profiler);
+    glDeleteProgram(profiler.program);
+    gl_reference_destroy(&glref);
+    reference_cache_destroy(ref_cache);
+    gl_iter_buffer_destroy(&iter_buffer);
+    if (opts.escape == ESCAPE_COMPUTE) {
+        gl_escape_compute_destroy(&escape_compute);
+    }
+    glDeleteProgram(colorize_program);
+    for (uint32_t v = 0; v < SHADER_VARIANT_COUNT; v++) {
+        if (escape_programs[v]) {
+            glDeleteProgram(escape_programs[v]);
+        }
+    }
+    cleanup(window);
 }
 
-uint32_t create_shader_program() {
-    char vert_source[1024];
-    char frag_source[1024];
+// source with defines right after its #version line, which has to stay
+// first, and then tail, if it isn't NULL; 0 if it doesn't compile
+uint32_t compile_with_defines(GLenum type, const char* what, const unsigned char* source, size_t length, const char* defines, const unsigned char* tail, size_t tail_length) {
+    size_t version_length = 0;
+    while (version_length < length && source[version_length++] != '\n') {}
+    // and #line keeps the compiler's line numbers matching the file; the
+    // tail counts as source string 1
+    char* inserted;
+    asprintf(&inserted, "%s#line 2\n", defines);
+
+    const char* parts[5] = { (const char*) source, inserted, (const char*) source + version_length, "\n#line 1 1\n", (const char*) tail };
+    int part_lengths[5] = { (int) version_length, (int) strlen(inserted), (int) (length - version_length), (int) strlen(parts[3]), (int) tail_length };
 
-    size_t trash = 0;
+    uint32_t shader = glCreateShader(type);
+    glShaderSource(shader, tail ? 5 : 3, parts, part_lengths);
+    glCompileShader(shader);
+    free(inserted);
 
-    if (!read_file("shader/main.vert", (unsigned char**)&vert_source, &trash)) {
-        fprintf(stderr, "Failed to read shader/main.vert\n");
+    int success;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    if (!success) {
+        char shader_log[1024];
+        glGetShaderInfoLog(shader, 1024, NULL, shader_log);
+        fprintf(stderr, "%s shader compilation failed:\n%s\n", what, shader_log);
+        glDeleteShader(shader);
+        return 0;
     }
+    return shader;
+}
 
-    if (!read_file("shader/main.frag", (unsigned char**)&frag_source, &trash)) {
-        fprintf(stderr, "Failed to read shader/main.frag\n");
+uint32_t link_program(uint32_t* shaders, uint32_t num_shaders) {
+    uint32_t program = glCreateProgram();
+    for (uint32_t i = 0; i < num_shaders; i++) {
+        glAttachShader(program, shaders[i]);
     }
+    glLinkProgram(program);
 
     int success;
-    int failed = 0;
-    char shader_log[1024];
-
-    uint32_t vert_shader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vert_shader, 1, (const char* const*)&vert_source, NULL);
-    glCompileShader(vert_shader);
-    glGetShaderiv(vert_shader, GL_COMPILE_STATUS, &success);
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
     if (!success) {
-        glGetShaderInfoLog(vert_shader, 1024, NULL, shader_log);
-        fprintf(stderr, "Vertex shader compilation failed:\n%s\n", shader_log);
-        failed = 1;
+        char shader_log[1024];
+        glGetProgramInfoLog(program, 1024, NULL, shader_log);
+        fprintf(stderr, "Shader program linking failed:\n%s\n", shader_log);
+        glDeleteProgram(program);
+        program = 0;
+    }
+    for (uint32_t i = 0; i < num_shaders; i++) {
+        glDeleteShader(shaders[i]);
     }
+    return program;
+}
 
-    uint32_t frag_shader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(frag_shader, 1, (const char* const*)&frag_source, NULL);
-    glCompileShader(frag_shader);
-    glGetShaderiv(frag_shader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        glGetShaderInfoLog(frag_shader, 1024, NULL, shader_log);
-        fprintf(stderr, "Vertex shader compilation failed:\n%s\n", shader_log);
-        failed = 1;
+// frag_defines go in right after frag_path's #version line
+uint32_t create_shader_program(const char* vert_path, const char* frag_path, const char* frag_defines) {
+    trace_begin("compile shader");
+    unsigned char* vert_source = NULL;
+    unsigned char* frag_source = NULL;
+    size_t vert_length = 0;
+    size_t frag_length = 0;
+
+    if (!read_file(vert_path, &vert_source, &vert_length)) {
+        fprintf(stderr, "Failed to read %s\n", vert_path);
     }
 
-    uint32_t shader_program = glCreateProgram();
-    glAttachShader(shader_program, vert_shader);
-    glAttachShader(shader_program, frag_shader);
-    glLinkProgram(shader_program);
-    glGetProgramiv(shader_program, GL_LINK_STATUS, &success);
-    if (!success) {
-        glGetProgramInfoLog(shader_program, 1024, NULL, shader_log);
-        fprintf(stderr, "Shader program linking failed:\n%s\n", shader_log);
-        failed = 1;
+    if (!read_file(frag_path, &frag_source, &frag_length)) {
+        fprintf(stderr, "Failed to read %s\n", frag_path);
     }
 
-    glDeleteShader(vert_shader);
-    glDeleteShader(frag_shader);
+    // read_file() doesn't null-terminate, so hand GL the lengths
+    uint32_t shaders[2] = {
+        compile_with_defines(GL_VERTEX_SHADER, "Vertex", vert_source, vert_length, "", NULL, 0),
+        compile_with_defines(GL_FRAGMENT_SHADER, "Fragment", frag_source, frag_length, frag_defines, NULL, 0),
+    };
+    uint32_t shader_program = (shaders[0] && shaders[1]) ? link_program(shaders, 2) : 0;
+    free(vert_source);
+    free(frag_source);
 
-    if (failed) {
+    if (!shader_program) {
         fprintf(stderr, "Exiting...\n");
         exit(-1);
     }
 
+    trace_end();
     return shader_program;
 }
 
-GLFWwindow* init_window() {
+// main.frag's code, with ESCAPE_COMPUTE and defines, then comp_path's
+// main(), as one compute shader
+uint32_t create_compute_program(const char* frag_path, const char* comp_path, const char* defines) {
+    trace_begin("compile shader");
+    unsigned char* frag_source = NULL;
+    unsigned char* comp_source = NULL;
+    size_t frag_length = 0;
+    size_t comp_length = 0;
+
+    if (!read_file(frag_path, &frag_source, &frag_length)) {
+        fprintf(stderr, "Failed to read %s\n", frag_path);
+    }
+
+    if (!read_file(comp_path, &comp_source, &comp_length)) {
+        fprintf(stderr, "Failed to read %s\n", comp_path);
+    }
+
+    char* compute_defines;
+    asprintf(&compute_defines, "#define ESCAPE_COMPUTE\n%s", defines);
+    uint32_t shader = compile_with_defines(GL_COMPUTE_SHADER, "Compute", frag_source, frag_length, compute_defines, comp_source, comp_length);
+    uint32_t program = shader ? link_program(&shader, 1) : 0;
+    free(compute_defines);
+    free(frag_source);
+    free(comp_source);
+
+    if (!program) {
+        fprintf(stderr, "Exiting...\n");
+        exit(-1);
+    }
+
+    trace_end();
+    return program;
+}
+
+// fp64 is core since 4.0, and older contexts can still have the extension
+bool gl_has_fp64() {
+    if (GLAD_GL_VERSION_4_0) {
+        return true;
+    }
+
+    int num_extensions = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &num_extensions);
+    for (int i = 0; i < num_extensions; i++) {
+        const char* extension = (const char*) glGetStringi(GL_EXTENSIONS, (uint32_t) i);
+        if (extension && strcmp(extension, "GL_ARB_gpu_shader_fp64") == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void get_escape_uniforms(uint32_t program, escape_uniforms_t* out) {
+    out->resolution = glGetUniformLocation(program, "u_resolution");
+    out->zoom = glGetUniformLocation(program, "u_zoom");
+    out->pan = glGetUniformLocation(program, "u_pan");
+    out->max_iter = glGetUniformLocation(program, "u_max_iter");
+    out->pan_df = glGetUniformLocation(program, "u_pan_df");
+    out->zoom_df = glGetUniformLocation(program, "u_zoom_df");
+    out->perturb = glGetUniformLocation(program, "u_perturb");
+    out->ref_len = glGetUniformLocation(program, "u_ref_len");
+    out->ref_c = glGetUniformLocation(program, "u_ref_c");
+    out->ref_offset = glGetUniformLocation(program, "u_ref_offset");
+    out->bla_levels = glGetUniformLocation(program, "u_bla_levels");
+    out->bla_offset = glGetUniformLocation(program, "u_bla_offset");
+    out->bla_count = glGetUniformLocation(program, "u_bla_count");
+    out->stride = glGetUniformLocation(program, "u_stride");
+    out->refine = glGetUniformLocation(program, "u_refine");
+    out->bulb_check = glGetUniformLocation(program, "u_bulb_check");
+    out->period_eps2 = glGetUniformLocation(program, "u_period_eps2");
+    out->rect = glGetUniformLocation(program, "u_rect");
+    out->first_pass = glGetUniformLocation(program, "u_first_pass");
+    out->fill_escaped = glGetUniformLocation(program, "u_fill_escaped");
+}
+
+// the double-double hi + lo as a double-float, about 48 bits, for
+// PRECISION_DOUBLE_FLOAT's uniforms
+void split_double_float(double hi, double lo, float* out_hi, float* out_lo) {
+    *out_hi = (float) hi;
+    *out_lo = (float) ((hi - *out_hi) + lo);
+}
+
+// user_input = false leaves the mouse to a replay
+GLFWwindow* init_window(bool user_input) {
     if (!glfwInit()) {
         fprintf(stderr, "Couldn't initialize GLFW!\n");
         exit(-1);
     }
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
+    // 4.5 is all the shaders need, and what Mesa's llvmpipe offers
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
     GLFWwindow* window = glfwCreateWindow(
@@ -264,10 +808,13 @@ GLFWwindow* init_window() {
     glfwSwapInterval(0);
 
     glfwSetFramebufferSizeCallback(window, resize_callback);
+    glfwSetWindowRefreshCallback(window, refresh_callback);
     glfwSetKeyCallback(window, key_callback);
-    glfwSetScrollCallback(window, scroll_callback);
-    glfwSetMouseButtonCallback(window, mouse_button_callback);
-    glfwSetCursorPosCallback(window, cursor_pos_callback);
+    if (user_input) {
+        glfwSetScrollCallback(window, scroll_callback);
+        glfwSetMouseButtonCallback(window, mouse_button_callback);
+        glfwSetCursorPosCallback(window, cursor_pos_callback);
+    }
 
     // printf("Window created\n");
     return window;
@@ -279,7 +826,7 @@ void process_input(GLFWwindow* window) {
     }
 }
 
-void cleanup(GLFWwindow* window, uint32_t shader_program) {
+void cleanup(GLFWwindow* window) {
     glfwDestroyWindow(window);
     glfwTerminate();
 }
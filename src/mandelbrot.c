@@ -0,0 +1,210 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <math.h>
+
+#include <mandelbrot.h>
+
+uint32_t mandelbrot_max_iter(double zoom) {
+    double max_iter = 2. / zoom + 100.;
+    if (!(max_iter < (double) MAX_ITER_CAP)) {
+        return MAX_ITER_CAP;
+    }
+    return (uint32_t) max_iter;
+}
+
+uint32_t view_max_iter(const view_t* view) {
+    return view->max_iter ? view->max_iter : mandelbrot_max_iter(view->zoom);
+}
+
+uint32_t mandelbrot_iterate(double cx, double cy, uint32_t max_iter) {
+    double zx = 0., zy = 0.;
+    uint32_t i;
+
+    for (i = 0; i < max_iter; i++) {
+        double zx2 = zx * zx;
+        double zy2 = zy * zy;
+        if (zx2 + zy2 > 4.) { break; }
+
+        zy = 2. * zx * zy + cy;
+        zx = zx2 - zy2 + cx;
+    }
+
+    return i;
+}
+
+uint32_t mandelbrot_iterate_periodic(double cx, double cy, uint32_t max_iter, double period_eps) {
+    if (period_eps <= 0.) {
+        return mandelbrot_iterate(cx, cy, max_iter);
+    }
+
+    double eps2 = period_eps * period_eps;
+    double zx = 0., zy = 0.;
+    double saved_x = 0., saved_y = 0.;
+    uint32_t next_save = 1;
+    uint32_t i;
+
+    for (i = 0; i < max_iter; i++) {
+        double zx2 = zx * zx;
+        double zy2 = zy * zy;
+        if (zx2 + zy2 > 4.) { break; }
+
+        zy = 2. * zx * zy + cy;
+        zx = zx2 - zy2 + cx;
+
+        double ex = zx - saved_x;
+        double ey = zy - saved_y;
+        if (ex * ex + ey * ey < eps2) {
+            return max_iter;
+        }
+        // the window doubles, so any period fits one eventually
+        if (i + 1 == next_save) {
+            saved_x = zx;
+            saved_y = zy;
+            next_save *= 2;
+        }
+    }
+
+    return i;
+}
+
+bool mandelbrot_in_main_bulbs(double cx, double cy) {
+    double y2 = cy * cy;
+
+    // cardioid: q (q + (x - 1/4)) <= y^2 / 4, q = (x - 1/4)^2 + y^2
+    double xq = cx - .25;
+    double q = xq * xq + y2;
+    if (q * (q + xq) <= .25 * y2) {
+        return true;
+    }
+
+    // period-2 bulb: the disc of radius 1/4 around -1
+    double xb = cx + 1.;
+    return xb * xb + y2 <= .0625;
+}
+
+static float ease_out_expo(float t) {
+    return (t == 1.f) ? 1.f : 1.f - exp2f(-10.f * t);
+}
+
+static uint8_t lerp_channel(uint8_t a, uint8_t b, float t) {
+    float v = (float) a + ((float) b - (float) a) * t;
+    return (uint8_t) lrintf(v);
+}
+
+palette_t palette_preset(uint32_t index) {
+    static const uint8_t presets[PALETTE_COUNT][2][3] = {
+        { { COLOR_START_R, COLOR_START_G, COLOR_START_B }, { COLOR_END_R, COLOR_END_G, COLOR_END_B } },
+        { { 8, 16, 48 }, { 200, 235, 255 } },       // ice
+        { { 40, 40, 40 }, { 255, 255, 255 } },      // grey
+    };
+
+    palette_t palette = { .exposure = 1.f, .smooth = false };
+    for (uint32_t c = 0; c < 3; c++) {
+        palette.start[c] = presets[index % PALETTE_COUNT][0][c];
+        palette.end[c] = presets[index % PALETTE_COUNT][1][c];
+    }
+    return palette;
+}
+
+void palette_colorize(const palette_t* palette, uint32_t iter, uint32_t max_iter, uint8_t* out_rgb) {
+    if (iter >= max_iter) {
+        out_rgb[0] = out_rgb[1] = out_rgb[2] = 0;
+        return;
+    }
+
+    float t = (float) iter / (float) (max_iter - 1) * palette->exposure;
+    t = ease_out_expo((t < 1.f) ? t : 1.f);
+    for (uint32_t c = 0; c < 3; c++) {
+        out_rgb[c] = lerp_channel(palette->start[c], palette->end[c], t);
+    }
+}
+
+void mandelbrot_colorize(uint32_t iter, uint32_t max_iter, uint8_t* out_rgb) {
+    palette_t palette = palette_preset(0);
+    palette_colorize(&palette, iter, max_iter, out_rgb);
+}
+
+void view_pixel_to_delta(const view_t* view, uint32_t px, uint32_t py, double* out_dx, double* out_dy) {
+    // matches screen2ndc(gl_FragCoord.xy): u_resolution is the smaller side,
+    // gl_FragCoord is the pixel center and its y axis points up
+    double scale = (view->width < view->height) ? view->width : view->height;
+    double frag_x = (double) px + .5;
+    double frag_y = (double) (view->height - py) - .5;
+
+    *out_dx = (frag_x / scale - .5) * 2. * view->zoom;
+    *out_dy = (frag_y / scale - .5) * 2. * view->zoom;
+}
+
+void view_pixel_to_complex(const view_t* view, uint32_t px, uint32_t py, double* out_cx, double* out_cy) {
+    view_pixel_to_delta(view, px, py, out_cx, out_cy);
+    *out_cx += view->pan_x;
+    *out_cy += view->pan_y;
+}
+
+void view_delta_to_pixel(const view_t* view, double dx, double dy, double* out_px, double* out_py) {
+    double scale = (view->width < view->height) ? view->width : view->height;
+    double frag_x = (dx / (2. * view->zoom) + .5) * scale;
+    double frag_y = (dy / (2. * view->zoom) + .5) * scale;
+
+    *out_px = frag_x - .5;
+    *out_py = (double) view->height - frag_y - .5;
+}
+
+double view_pixel_size(const view_t* view) {
+    double scale = (view->width < view->height) ? view->width : view->height;
+    return 2. * view->zoom / scale;
+}
+
+// a shift this close to whole pixels lands every pixel center on another one
+#define SHIFT_TOLERANCE 1e-3
+
+bool view_pixel_shift(const view_t* from, const view_t* to, int32_t* out_dx, int32_t* out_dy) {
+    if (from->width != to->width || from->height != to->height || from->zoom != to->zoom) {
+        return false;
+    }
+    if (view_max_iter(from) != view_max_iter(to)) {
+        return false;
+    }
+
+    // panning right moves the picture left; complex y points up, rows down
+    double pixel_size = view_pixel_size(to);
+    // hi parts first: they're close, so that difference is exact
+    double dx = ((from->pan_x - to->pan_x) + (from->pan_x_lo - to->pan_x_lo)) / pixel_size;
+    double dy = ((to->pan_y - from->pan_y) + (to->pan_y_lo - from->pan_y_lo)) / pixel_size;
+    if (fabs(dx - round(dx)) > SHIFT_TOLERANCE || fabs(dy - round(dy)) > SHIFT_TOLERANCE) {
+        return false;
+    }
+    if (fabs(dx) >= (double) to->width || fabs(dy) >= (double) to->height) {
+        return false;
+    }
+
+    *out_dx = (int32_t) round(dx);
+    *out_dy = (int32_t) round(dy);
+    return true;
+}
+
+uint32_t view_exposed_rects(uint32_t width, uint32_t height, int32_t dx, int32_t dy, pixel_rect_t* out_rects) {
+    uint32_t num_rects = 0;
+    uint32_t adx = (uint32_t) abs(dx);
+    uint32_t ady = (uint32_t) abs(dy);
+    if (adx >= width || ady >= height) {
+        out_rects[0] = (pixel_rect_t) { 0, 0, width, height };
+        return 1;
+    }
+
+    // columns the shift pulled in, full height
+    uint32_t col_x0 = (dx > 0) ? 0 : width - adx;
+    if (adx > 0) {
+        out_rects[num_rects++] = (pixel_rect_t) { col_x0, 0, col_x0 + adx, height };
+    }
+
+    // rows the shift pulled in, minus what the columns already cover
+    if (ady > 0) {
+        uint32_t row_y0 = (dy > 0) ? 0 : height - ady;
+        uint32_t x0 = (dx > 0) ? adx : 0;
+        uint32_t x1 = (dx > 0) ? width : width - adx;
+        out_rects[num_rects++] = (pixel_rect_t) { x0, row_y0, x1, row_y0 + ady };
+    }
+    return num_rects;
+}
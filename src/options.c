@@ -0,0 +1,352 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include <bignum.h>
+#include <options.h>
+#include <util.h>
+
+static void usage(const char* prog) {
+    fprintf(stderr,
+        "usage: %s [options]\n"
+        "  --backend=gl|cpu     gl: interactive window (default), cpu: headless render\n"
+        "  --redraw=MODE        gl: on-change|always (default on-change)\n"
+        "  --progressive=on|off gl: show 1/8, 1/4, 1/2 resolution first after a change (default on)\n"
+        "  --shader-precision=P gl: auto|float|double-float|fp64, auto = cheapest that resolves the view (default auto)\n"
+        "  --escape=PASS        gl: fragment|compute, iterate per fragment, or by tiles in a compute shader\n"
+        "                       that fills tiles with an interior border without iterating them (default fragment)\n"
+        "  --record=FILE        gl: log scroll, cursor and mouse button events to FILE\n"
+        "  --replay=FILE        gl: play a --record log back (window size and view included), then\n"
+        "                       print each event's input to present latency and quit\n"
+        "  --replay-speed=S     gl: recorded|fast, fast = next event as soon as the last one is shown (default recorded)\n"
+        "  --profile            gl: start with the frame profiler overlay up (T toggles it)\n"
+        "  --profile-csv=FILE   gl: write every frame's CPU and GPU time per render stage to FILE\n"
+        "  --trace=FILE         write a Chrome trace (chrome://tracing, Perfetto) of every thread to FILE at exit\n"
+        "  --width=N            image width in pixels (default 1000)\n"
+        "  --height=N           image height in pixels (default 1000)\n"
+        "  --zoom=Z             zoom factor, smaller is deeper (default 1)\n"
+        "  --pan=X,Y            complex-plane offset of the view (default 0,0), decimal with any number of digits\n"
+        "  --max-iter=N         iteration budget, 0 = 2 / zoom + 100 (default 0)\n"
+        "  --palette=N          color preset 0-%d (default 0)\n"
+        "  --exposure=X         stretches the color ramp (default 1)\n"
+        "  --smooth             gl: continuous coloring instead of iteration bands\n"
+        "  --perturb=MODE       auto|on|off deep zoom perturbation (default auto)\n"
+        "  --bla=on|off         bilinear approximation on top of perturbation (default on)\n"
+        "  --bulb-check=on|off  skip iterating the main cardioid and period-2 bulb (default on)\n"
+        "  --periodicity=on|off stop interior orbits once they cycle (default on)\n"
+        "  --period-tolerance=X how close, in pixels, a cycle has to return (default %g)\n"
+        "  --max-refs=N         cpu: secondary references to fix glitched pixels, 0 = only count (default 32)\n"
+        "  --ref-cache=MB       reference orbits kept in memory for when the view comes back (default 256)\n"
+        "  --ref-cache-dir=DIR  spill orbits past --ref-cache to DIR and reuse them in later runs\n"
+        "  --threads=N          cpu: worker threads, 0 = all cores (default 0)\n"
+        "  --tile-size=N        cpu: tile edge in pixels (default 64)\n"
+        "  --frames=N           cpu: render N times and report the average (default 1)\n"
+        "  --pan-step=DX,DY     cpu: pan every frame after the first by DX,DY pixels (default 0,0)\n"
+        "  --pan-reuse=on|off   cpu: when panning, render only the newly exposed pixels (default on)\n"
+        "  --subdivide=MODE     cpu: off|on|verify, fill rects with a one-count border without\n"
+        "                       iterating them; verify checks every filled pixel (default off).\n"
+        "                       gl: on also lets --escape=compute fill escaped borders\n"
+        "  --output=FILE        cpu: write the last frame to FILE as PPM\n"
+        "  --export=FILE        cpu: render --width x --height a band of tiles at a time straight into\n"
+        "                       FILE (.png, .tif/.tiff or PPM), for images bigger than memory\n"
+        "  --video=PATTERN      cpu: zoom video from --video-start in to --zoom, frames resampled from a\n"
+        "                       2x keyframe per octave; PATTERN is a printf file name (frame%%05d.png)\n"
+        "                       or - for raw RGB24 frames on stdout\n"
+        "  --video-start=Z      cpu: zoom of the video's first frame (default 1)\n"
+        "  --frames-per-octave=N cpu: video frames per halving of the zoom (default 60)\n"
+        "  --isa=NAME           cpu: auto|scalar|sse2|avx2|avx512 (default auto)\n"
+        "  --isa-bench          cpu: report pixels/s for every isa this CPU supports\n"
+        "  --bulb-bench         cpu: report frame times with --bulb-check off and on\n"
+        "  --schedule=NAME      cpu: steal|static tile scheduling (default steal)\n"
+        "  --sched-stats        cpu: print per-worker tile and steal counts\n",
+        prog, PALETTE_COUNT - 1, PERIOD_DEFAULT_TOLERANCE
+    );
+}
+
+static bool parse_i32(const char* s, int32_t* out) {
+    char* end;
+    long v = strtol(s, &end, 10);
+    if (*s == '\0' || *end != '\0' || v < INT32_MIN || v > INT32_MAX) {
+        return false;
+    }
+    *out = (int32_t) v;
+    return true;
+}
+
+static bool parse_double(const char* s, double* out) {
+    char* end;
+    *out = strtod(s, &end);
+    return *s != '\0' && *end == '\0';
+}
+
+static bool parse_on_off(const char* s, bool* out) {
+    if (strcmp(s, "on") == 0) {
+        *out = true;
+    } else if (strcmp(s, "off") == 0) {
+        *out = false;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// "a,b" -> both halves as int32s
+static bool parse_i32_pair(const char* s, int32_t* out_a, int32_t* out_b) {
+    const char* comma = strchr(s, ',');
+    if (!comma) {
+        return false;
+    }
+
+    char* a_str = strndup(s, (size_t) (comma - s));
+    bool ok = parse_i32(a_str, out_a) && parse_i32(comma + 1, out_b);
+    free(a_str);
+    return ok;
+}
+
+// what bignum_set_decimal() takes, since the strings end up there: strtod()
+// would also take hex, inf and nan, which the reference orbit can't
+static bool is_decimal(const char* s) {
+    bignum_t* check = bignum_create(1);
+    bool ok = bignum_set_decimal(check, s);
+    bignum_destroy(check);
+    return ok;
+}
+
+// "a,b" -> both halves as doubles and as strings, plain decimal only
+static bool parse_pair(const char* s, double* out_a, double* out_b, const char** out_a_str, const char** out_b_str) {
+    const char* comma = strchr(s, ',');
+    if (!comma) {
+        return false;
+    }
+
+    char* a_str = strndup(s, (size_t) (comma - s));
+    char* b_str = strdup(comma + 1);
+    if (!is_decimal(a_str) || !is_decimal(b_str) || !parse_double(a_str, out_a) || !parse_double(b_str, out_b)) {
+        free(a_str);
+        free(b_str);
+        return false;
+    }
+
+    *out_a_str = a_str;
+    *out_b_str = b_str;
+    return true;
+}
+
+void options_parse(options_t* opts, int argc, char** argv) {
+    *opts = (options_t) {
+        .backend = BACKEND_GL,
+        .redraw = REDRAW_ON_CHANGE,
+        .progressive = true,
+        .shader_precision = SHADER_PRECISION_AUTO,
+        .escape = ESCAPE_FRAGMENT,
+        .record = NULL,
+        .replay = NULL,
+        .replay_fast = false,
+        .profile = false,
+        .profile_csv = NULL,
+        .trace = NULL,
+        .width = 1000,
+        .height = 1000,
+        .zoom = 1.,
+        .pan_x = 0.,
+        .pan_y = 0.,
+        .pan_re = "0",
+        .pan_im = "0",
+        .max_iter = 0,
+        .palette = 0,
+        .exposure = 1.f,
+        .smooth = false,
+        .perturb = PERTURB_AUTO,
+        .bla = true,
+        .max_refs = CPU_DEFAULT_MAX_REFERENCES,
+        .ref_cache_mb = 256,
+        .ref_cache_dir = NULL,
+        .threads = 0,
+        .tile_size = 0,
+        .frames = 1,
+        .pan_step_x = 0,
+        .pan_step_y = 0,
+        .pan_reuse = true,
+        .subdivide = SUBDIVIDE_OFF,
+        .subdivide_verify = false,
+        .output = NULL,
+        .export_path = NULL,
+        .video = NULL,
+        .video_start_zoom = 1.,
+        .frames_per_octave = 60,
+        .isa = ISA_AUTO,
+        .isa_bench = false,
+        .bulb_check = true,
+        .periodicity = true,
+        .period_tolerance = PERIOD_DEFAULT_TOLERANCE,
+        .bulb_bench = false,
+        .schedule = SCHEDULE_STEAL,
+        .sched_stats = false,
+    };
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* v;
+        bool ok = true;
+
+        if ((v = flag_value(arg, "--backend"))) {
+            if (strcmp(v, "gl") == 0) {
+                opts->backend = BACKEND_GL;
+            } else if (strcmp(v, "cpu") == 0) {
+                opts->backend = BACKEND_CPU;
+            } else {
+                ok = false;
+            }
+        } else if ((v = flag_value(arg, "--progressive"))) {
+            ok = parse_on_off(v, &opts->progressive);
+        } else if ((v = flag_value(arg, "--shader-precision"))) {
+            if (strcmp(v, "auto") == 0) {
+                opts->shader_precision = SHADER_PRECISION_AUTO;
+            } else if (strcmp(v, "float") == 0) {
+                opts->shader_precision = SHADER_PRECISION_FLOAT;
+            } else if (strcmp(v, "double-float") == 0) {
+                opts->shader_precision = SHADER_PRECISION_DOUBLE_FLOAT;
+            } else if (strcmp(v, "fp64") == 0) {
+                opts->shader_precision = SHADER_PRECISION_FP64;
+            } else {
+                ok = false;
+            }
+        } else if ((v = flag_value(arg, "--escape"))) {
+            if (strcmp(v, "fragment") == 0) {
+                opts->escape = ESCAPE_FRAGMENT;
+            } else if (strcmp(v, "compute") == 0) {
+                opts->escape = ESCAPE_COMPUTE;
+            } else {
+                ok = false;
+            }
+        } else if ((v = flag_value(arg, "--redraw"))) {
+            if (strcmp(v, "on-change") == 0) {
+                opts->redraw = REDRAW_ON_CHANGE;
+            } else if (strcmp(v, "always") == 0) {
+                opts->redraw = REDRAW_ALWAYS;
+            } else {
+                ok = false;
+            }
+        } else if ((v = flag_value(arg, "--record"))) {
+            opts->record = v;
+        } else if ((v = flag_value(arg, "--replay"))) {
+            opts->replay = v;
+        } else if ((v = flag_value(arg, "--replay-speed"))) {
+            if (strcmp(v, "recorded") == 0) {
+                opts->replay_fast = false;
+            } else if (strcmp(v, "fast") == 0) {
+                opts->replay_fast = true;
+            } else {
+                ok = false;
+            }
+        } else if (strcmp(arg, "--profile") == 0) {
+            opts->profile = true;
+        } else if ((v = flag_value(arg, "--profile-csv"))) {
+            opts->profile_csv = v;
+        } else if ((v = flag_value(arg, "--trace"))) {
+            opts->trace = v;
+        } else if ((v = flag_value(arg, "--width"))) {
+            ok = parse_u32(v, &opts->width) && opts->width > 0;
+        } else if ((v = flag_value(arg, "--height"))) {
+            ok = parse_u32(v, &opts->height) && opts->height > 0;
+        } else if ((v = flag_value(arg, "--zoom"))) {
+            ok = parse_double(v, &opts->zoom) && opts->zoom > 0.;
+        } else if ((v = flag_value(arg, "--pan"))) {
+            ok = parse_pair(v, &opts->pan_x, &opts->pan_y, &opts->pan_re, &opts->pan_im);
+        } else if ((v = flag_value(arg, "--max-iter"))) {
+            ok = parse_u32(v, &opts->max_iter);
+        } else if ((v = flag_value(arg, "--palette"))) {
+            ok = parse_u32(v, &opts->palette) && opts->palette < PALETTE_COUNT;
+        } else if ((v = flag_value(arg, "--exposure"))) {
+            double exposure;
+            ok = parse_double(v, &exposure) && exposure > 0.;
+            opts->exposure = (float) exposure;
+        } else if (strcmp(arg, "--smooth") == 0) {
+            opts->smooth = true;
+        } else if ((v = flag_value(arg, "--perturb"))) {
+            if (strcmp(v, "auto") == 0) {
+                opts->perturb = PERTURB_AUTO;
+            } else if (strcmp(v, "on") == 0) {
+                opts->perturb = PERTURB_ON;
+            } else if (strcmp(v, "off") == 0) {
+                opts->perturb = PERTURB_OFF;
+            } else {
+                ok = false;
+            }
+        } else if ((v = flag_value(arg, "--bla"))) {
+            ok = parse_on_off(v, &opts->bla);
+        } else if ((v = flag_value(arg, "--max-refs"))) {
+            ok = parse_u32(v, &opts->max_refs);
+        } else if ((v = flag_value(arg, "--ref-cache"))) {
+            ok = parse_u32(v, &opts->ref_cache_mb);
+        } else if ((v = flag_value(arg, "--ref-cache-dir"))) {
+            opts->ref_cache_dir = v;
+        } else if ((v = flag_value(arg, "--threads"))) {
+            ok = parse_u32(v, &opts->threads);
+        } else if ((v = flag_value(arg, "--tile-size"))) {
+            ok = parse_u32(v, &opts->tile_size);
+        } else if ((v = flag_value(arg, "--frames"))) {
+            ok = parse_u32(v, &opts->frames) && opts->frames > 0;
+        } else if ((v = flag_value(arg, "--pan-step"))) {
+            ok = parse_i32_pair(v, &opts->pan_step_x, &opts->pan_step_y);
+        } else if ((v = flag_value(arg, "--pan-reuse"))) {
+            ok = parse_on_off(v, &opts->pan_reuse);
+        } else if ((v = flag_value(arg, "--subdivide"))) {
+            if (strcmp(v, "off") == 0) {
+                opts->subdivide = SUBDIVIDE_OFF;
+            } else if (strcmp(v, "on") == 0) {
+                opts->subdivide = SUBDIVIDE_ON;
+            } else if (strcmp(v, "verify") == 0) {
+                opts->subdivide = SUBDIVIDE_ON;
+                opts->subdivide_verify = true;
+            } else {
+                ok = false;
+            }
+        } else if ((v = flag_value(arg, "--output"))) {
+            opts->output = v;
+        } else if ((v = flag_value(arg, "--export"))) {
+            opts->export_path = v;
+        } else if ((v = flag_value(arg, "--video"))) {
+            opts->video = v;
+        } else if ((v = flag_value(arg, "--video-start"))) {
+            ok = parse_double(v, &opts->video_start_zoom) && opts->video_start_zoom > 0.;
+        } else if ((v = flag_value(arg, "--frames-per-octave"))) {
+            ok = parse_u32(v, &opts->frames_per_octave) && opts->frames_per_octave > 0;
+        } else if ((v = flag_value(arg, "--isa"))) {
+            ok = isa_from_name(v, &opts->isa);
+        } else if (strcmp(arg, "--isa-bench") == 0) {
+            opts->isa_bench = true;
+        } else if (strcmp(arg, "--bulb-bench") == 0) {
+            opts->bulb_bench = true;
+        } else if ((v = flag_value(arg, "--periodicity"))) {
+            ok = parse_on_off(v, &opts->periodicity);
+        } else if ((v = flag_value(arg, "--period-tolerance"))) {
+            ok = parse_double(v, &opts->period_tolerance) && opts->period_tolerance > 0.;
+        } else if ((v = flag_value(arg, "--bulb-check"))) {
+            ok = parse_on_off(v, &opts->bulb_check);
+        } else if ((v = flag_value(arg, "--schedule"))) {
+            if (strcmp(v, "steal") == 0) {
+                opts->schedule = SCHEDULE_STEAL;
+            } else if (strcmp(v, "static") == 0) {
+                opts->schedule = SCHEDULE_STATIC;
+            } else {
+                ok = false;
+            }
+        } else if (strcmp(arg, "--sched-stats") == 0) {
+            opts->sched_stats = true;
+        } else if (strcmp(arg, "--help") == 0 || strcmp(arg, "-h") == 0) {
+            usage(argv[0]);
+            exit(0);
+        } else {
+            ok = false;
+        }
+
+        if (!ok) {
+            fprintf(stderr, "Bad argument: %s\n", arg);
+            usage(argv[0]);
+            exit(-1);
+        }
+    }
+}
@@ -0,0 +1,270 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <math.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include <bignum.h>
+#include <perturbation.h>
+#include <trace.h>
+
+// bits past the pixel size, so rounding in the orbit stays below a pixel
+// even after it has been amplified for a while
+#define GUARD_BITS 64
+
+// below this many limbs a multiply takes about as long as handing it to
+// another core and back (~16 limbs = 480 bits: a quarter microsecond)
+#define PARALLEL_MIN_LIMBS 16
+#define WAIT_SPINS 4096
+// how often progress is published and cancel looked at
+#define PROGRESS_INTERVAL 4096
+
+uint32_t perturb_precision_bits(double pixel_size) {
+    double bits = -log2(pixel_size);
+    return ((bits > 0.) ? (uint32_t) ceil(bits) : 0) + GUARD_BITS;
+}
+
+// the helper thread's side of an iteration: xy for the x, y of the latest
+// posted iteration, while the main thread does x^2 and y^2
+typedef struct {
+    const bignum_t* x;
+    const bignum_t* y;
+    bignum_t* xy;
+
+    atomic_uint_fast64_t posted;    // iterations handed over
+    atomic_uint_fast64_t finished;  // ... and done
+    atomic_bool stop;
+} cross_term_t;
+
+// the other side is usually a microsecond away, so spin before yielding
+static void wait_for(atomic_uint_fast64_t* counter, uint64_t target, atomic_bool* stop) {
+    uint32_t spins = 0;
+    while (atomic_load_explicit(counter, memory_order_acquire) < target) {
+        if (stop && atomic_load_explicit(stop, memory_order_relaxed)) {
+            return;
+        }
+        if (++spins > WAIT_SPINS) {
+            sched_yield();
+        }
+    }
+}
+
+static void* cross_term_main(void* arg) {
+    cross_term_t* ct = arg;
+    trace_thread_name("cross term");
+    trace_begin("cross terms");
+
+    for (uint64_t n = 1;; n++) {
+        wait_for(&ct->posted, n, &ct->stop);
+        if (atomic_load_explicit(&ct->stop, memory_order_relaxed)) {
+            break;
+        }
+        bignum_mul(ct->xy, ct->x, ct->y);
+        atomic_store_explicit(&ct->finished, n, memory_order_release);
+    }
+    trace_end();
+    return NULL;
+}
+
+static reference_orbit_t* orbit_create(const bignum_t* c_re, const bignum_t* c_im, uint32_t precision_bits) {
+    uint32_t num_limbs = bignum_limbs_for_bits(precision_bits);
+
+    reference_orbit_t* ref = malloc(sizeof(*ref));
+    ref->c_re = bignum_create(num_limbs);
+    ref->c_im = bignum_create(num_limbs);
+    // whatever the last limb has room for comes for free
+    ref->precision_bits = (num_limbs - 1) * BIGNUM_LIMB_BITS;
+    ref->max_iter = 0;
+    ref->orbit = NULL;
+    ref->length = 0;
+    ref->escaped = false;
+    ref->z_re = bignum_create(num_limbs);
+    ref->z_im = bignum_create(num_limbs);
+
+    bignum_copy(ref->c_re, c_re);
+    bignum_copy(ref->c_im, c_im);
+    ref->c_re_d = bignum_to_double(ref->c_re);
+    ref->c_im_d = bignum_to_double(ref->c_im);
+    return ref;
+}
+
+// carries ref on from Z_length up to max_iter
+static void orbit_iterate(reference_orbit_t* ref, uint32_t max_iter, bool parallel, reference_progress_t* progress) {
+    if (ref->escaped || ref->length >= max_iter) {
+        return;
+    }
+    trace_begin("reference orbit");
+
+    uint32_t num_limbs = ref->c_re->num_limbs;
+    ref->orbit = realloc(ref->orbit, (size_t) max_iter * 2 * sizeof(double));
+    ref->max_iter = max_iter;
+
+    bignum_t* x = ref->z_re;
+    bignum_t* y = ref->z_im;
+    bignum_t* x2 = bignum_create(num_limbs);
+    bignum_t* y2 = bignum_create(num_limbs);
+    bignum_t* xy = bignum_create(num_limbs);
+
+    cross_term_t ct = { .x = x, .y = y, .xy = xy };
+    atomic_init(&ct.posted, 0);
+    atomic_init(&ct.finished, 0);
+    atomic_init(&ct.stop, false);
+    pthread_t helper;
+    parallel = parallel && num_limbs >= PARALLEL_MIN_LIMBS && sysconf(_SC_NPROCESSORS_ONLN) > 1
+        && pthread_create(&helper, NULL, cross_term_main, &ct) == 0;
+    uint64_t handoffs = 0;
+
+    for (uint32_t n = ref->length; n < max_iter; n++) {
+        if (progress && n % PROGRESS_INTERVAL == 0) {
+            atomic_store_explicit(&progress->iterations, n, memory_order_relaxed);
+            if (atomic_load_explicit(&progress->cancel, memory_order_relaxed)) {
+                // Z_n is still in (x, y) for whoever carries on
+                ref->max_iter = n;
+                break;
+            }
+        }
+
+        double zx = bignum_to_double(x);
+        double zy = bignum_to_double(y);
+        ref->orbit[2 * n] = zx;
+        ref->orbit[2 * n + 1] = zy;
+        ref->length = n + 1;
+
+        if (zx * zx + zy * zy > 4.) {
+            ref->escaped = true;
+            break;
+        }
+
+        if (parallel) {
+            atomic_store_explicit(&ct.posted, ++handoffs, memory_order_release);
+        } else {
+            bignum_mul(xy, x, y);
+        }
+        bignum_sqr(x2, x);
+        bignum_sqr(y2, y);
+        if (parallel) {
+            wait_for(&ct.finished, handoffs, NULL);
+        }
+
+        // x = x^2 - y^2 + cx, y = 2xy + cy
+        bignum_sub(x, x2, y2);
+        bignum_add(x, x, ref->c_re);
+        bignum_mul2(y, xy);
+        bignum_add(y, y, ref->c_im);
+    }
+
+    if (parallel) {
+        atomic_store_explicit(&ct.stop, true, memory_order_relaxed);
+        pthread_join(helper, NULL);
+    }
+    if (progress) {
+        atomic_store_explicit(&progress->iterations, ref->length, memory_order_relaxed);
+    }
+
+    bignum_destroy(xy);
+    bignum_destroy(y2);
+    bignum_destroy(x2);
+    trace_end();
+}
+
+reference_orbit_t* reference_orbit_compute(const bignum_t* c_re, const bignum_t* c_im, uint32_t precision_bits, uint32_t max_iter) {
+    reference_orbit_t* ref = orbit_create(c_re, c_im, precision_bits);
+    orbit_iterate(ref, max_iter, false, NULL);
+    return ref;
+}
+
+reference_orbit_t* reference_orbit_compute_parallel(const bignum_t* c_re, const bignum_t* c_im, uint32_t precision_bits, uint32_t max_iter, reference_progress_t* progress) {
+    reference_orbit_t* ref = orbit_create(c_re, c_im, precision_bits);
+    orbit_iterate(ref, max_iter, true, progress);
+    return ref;
+}
+
+void reference_orbit_extend(reference_orbit_t* ref, uint32_t max_iter, reference_progress_t* progress) {
+    orbit_iterate(ref, max_iter, true, progress);
+}
+
+reference_orbit_t* reference_orbit_offset(const reference_orbit_t* ref, double dcx, double dcy, uint32_t max_iter) {
+    uint32_t num_limbs = bignum_limbs_for_bits(ref->precision_bits);
+    bignum_t* c_re = bignum_create(num_limbs);
+    bignum_t* c_im = bignum_create(num_limbs);
+    bignum_t* d = bignum_create(num_limbs);
+
+    bignum_set_double(d, dcx);
+    bignum_add(c_re, ref->c_re, d);
+    bignum_set_double(d, dcy);
+    bignum_add(c_im, ref->c_im, d);
+    reference_orbit_t* secondary = reference_orbit_compute(c_re, c_im, ref->precision_bits, max_iter);
+
+    bignum_destroy(d);
+    bignum_destroy(c_im);
+    bignum_destroy(c_re);
+    return secondary;
+}
+
+void reference_orbit_destroy(reference_orbit_t* ref) {
+    bignum_destroy(ref->c_re);
+    bignum_destroy(ref->c_im);
+    bignum_destroy(ref->z_re);
+    bignum_destroy(ref->z_im);
+    free(ref->orbit);
+    free(ref);
+}
+
+uint32_t perturb_iterate(const reference_orbit_t* ref, double dcx, double dcy, uint32_t max_iter) {
+    const double* orbit = ref->orbit;
+    uint32_t limit = (max_iter < ref->length) ? max_iter : ref->length;
+    double dzx = 0., dzy = 0.;
+    double zx = 0., zy = 0.;
+    uint32_t i;
+
+    for (i = 0; i < limit; i++) {
+        double ref_x = orbit[2 * i];
+        double ref_y = orbit[2 * i + 1];
+
+        zx = ref_x + dzx;
+        zy = ref_y + dzy;
+        double z2 = zx * zx + zy * zy;
+        if (z2 > 4.) { return i; }
+        if (z2 < PERTURB_GLITCH_TOLERANCE * (ref_x * ref_x + ref_y * ref_y)) { return PERTURB_GLITCHED; }
+
+        // dz' = 2 Z dz + dz^2 + dc
+        double new_dzx = 2. * (ref_x * dzx - ref_y * dzy) + (dzx * dzx - dzy * dzy) + dcx;
+        double new_dzy = 2. * (ref_x * dzy + ref_y * dzx) + 2. * dzx * dzy + dcy;
+        dzx = new_dzx;
+        dzy = new_dzy;
+    }
+
+    if (i >= max_iter) {
+        return max_iter;
+    }
+
+    return perturb_finish(ref, zx, zy, dcx, dcy, i, max_iter);
+}
+
+uint32_t perturb_finish(const reference_orbit_t* ref, double zx, double zy, double dcx, double dcy, uint32_t i, uint32_t max_iter) {
+    // the reference escaped first; finish this pixel on its own, at whatever
+    // precision plain double has left
+    double cx = ref->c_re_d + dcx;
+    double cy = ref->c_im_d + dcy;
+    double new_zx = zx * zx - zy * zy + cx;
+    zy = 2. * zx * zy + cy;
+    zx = new_zx;
+
+    for (; i < max_iter; i++) {
+        double zx2 = zx * zx;
+        double zy2 = zy * zy;
+        if (zx2 + zy2 > 4.) { break; }
+
+        zy = 2. * zx * zy + cy;
+        zx = zx2 - zy2 + cx;
+    }
+    return i;
+}
+
+void perturb_row(const reference_orbit_t* ref, double dcx0, double dx, double dcy, uint32_t count, uint32_t max_iter, uint32_t* out_iter) {
+    for (uint32_t k = 0; k < count; k++) {
+        out_iter[k] = perturb_iterate(ref, dcx0 + k * dx, dcy, max_iter);
+    }
+}
@@ -0,0 +1,419 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <math.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <bignum.h>
+#include <bla.h>
+#include <perturbation.h>
+#include <reference_cache.h>
+
+// spill files: this header, then the c_re, c_im, z_re and z_im limbs
+// (num_limbs each), then the orbit's 2 * length doubles. native byte order,
+// they're a cache and not meant to travel
+#define SPILL_MAGIC "mbrefv01"
+#define SPILL_SUFFIX ".orbit"
+
+typedef struct {
+    char magic[8];
+    uint32_t precision_bits;
+    uint32_t max_iter;
+    uint32_t length;
+    uint32_t escaped;
+    uint32_t num_limbs;
+    uint32_t negative;      // bit 0 c_re, 1 c_im, 2 z_re, 3 z_im
+} spill_header_t;
+
+typedef struct {
+    // the key, kept even while the orbit itself is only on disk
+    bignum_t* c_re;
+    bignum_t* c_im;
+    uint32_t precision_bits;
+    uint32_t length;
+    bool escaped;
+
+    reference_orbit_t* ref;     // NULL while it's only on disk
+    bla_table_t* bla;
+    char* path;                 // spill file, NULL if there's none yet
+    bool spill_current;         // path holds the orbit as it is now
+    uint64_t last_used;
+} cache_entry_t;
+
+struct reference_cache {
+    size_t max_bytes;
+    char* spill_dir;
+
+    cache_entry_t* entries;
+    uint32_t num_entries;
+    uint32_t capacity;
+    uint64_t clock;
+
+    reference_cache_stats_t stats;
+};
+
+static size_t entry_bytes(const cache_entry_t* entry) {
+    if (!entry->ref) {
+        return 0;
+    }
+    size_t bytes = (size_t) entry->ref->max_iter * 2 * sizeof(double)
+        + 4 * (size_t) entry->ref->c_re->num_limbs * sizeof(uint32_t);
+    if (entry->bla) {
+        bytes += (size_t) entry->bla->num_steps * sizeof(bla_step_t);
+    }
+    return bytes;
+}
+
+static size_t total_bytes(const reference_cache_t* cache) {
+    size_t bytes = 0;
+    for (uint32_t i = 0; i < cache->num_entries; i++) {
+        bytes += entry_bytes(&cache->entries[i]);
+    }
+    return bytes;
+}
+
+static cache_entry_t* append_entry(reference_cache_t* cache) {
+    if (cache->num_entries == cache->capacity) {
+        cache->capacity = cache->capacity ? 2 * cache->capacity : 16;
+        cache->entries = realloc(cache->entries, cache->capacity * sizeof(cache_entry_t));
+    }
+    cache_entry_t* entry = &cache->entries[cache->num_entries++];
+    memset(entry, 0, sizeof(*entry));
+    return entry;
+}
+
+static void free_loaded(cache_entry_t* entry) {
+    if (entry->bla) {
+        bla_table_destroy(entry->bla);
+        entry->bla = NULL;
+    }
+    if (entry->ref) {
+        reference_orbit_destroy(entry->ref);
+        entry->ref = NULL;
+    }
+}
+
+// drops entry i from the index; its file, if any, stays
+static void remove_entry(reference_cache_t* cache, uint32_t i, bool free_orbit) {
+    cache_entry_t* entry = &cache->entries[i];
+    if (free_orbit) {
+        free_loaded(entry);
+    }
+    bignum_destroy(entry->c_re);
+    bignum_destroy(entry->c_im);
+    free(entry->path);
+    cache->entries[i] = cache->entries[--cache->num_entries];
+}
+
+// FNV-1a over the precision and C, for the spill file name
+static uint64_t key_hash(const bignum_t* c_re, const bignum_t* c_im, uint32_t precision_bits) {
+    uint64_t h = 0xcbf29ce484222325ull;
+    const bignum_t* parts[2] = { c_re, c_im };
+    h = (h ^ precision_bits) * 0x100000001b3ull;
+    for (uint32_t p = 0; p < 2; p++) {
+        h = (h ^ parts[p]->negative) * 0x100000001b3ull;
+        for (uint32_t i = 0; i < parts[p]->num_limbs; i++) {
+            h = (h ^ parts[p]->limbs[i]) * 0x100000001b3ull;
+        }
+    }
+    return h;
+}
+
+static char* join_path(const char* dir, const char* name) {
+    size_t size = strlen(dir) + 1 + strlen(name) + 1;
+    char* path = malloc(size);
+    snprintf(path, size, "%s/%s", dir, name);
+    return path;
+}
+
+static bool write_spill(reference_cache_t* cache, cache_entry_t* entry) {
+    const reference_orbit_t* ref = entry->ref;
+    if (!entry->path) {
+        char name[32];
+        snprintf(name, sizeof(name), "%016" PRIx64 SPILL_SUFFIX, key_hash(ref->c_re, ref->c_im, ref->precision_bits));
+        entry->path = join_path(cache->spill_dir, name);
+    }
+
+    FILE* f = fopen(entry->path, "wb");
+    if (!f) {
+        fprintf(stderr, "Couldn't write %s\n", entry->path);
+        return false;
+    }
+
+    spill_header_t header = {
+        .precision_bits = ref->precision_bits,
+        .max_iter = ref->max_iter,
+        .length = ref->length,
+        .escaped = ref->escaped,
+        .num_limbs = ref->c_re->num_limbs,
+        .negative = ref->c_re->negative | ref->c_im->negative << 1 | ref->z_re->negative << 2 | ref->z_im->negative << 3,
+    };
+    memcpy(header.magic, SPILL_MAGIC, sizeof(header.magic));
+
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+    const bignum_t* parts[4] = { ref->c_re, ref->c_im, ref->z_re, ref->z_im };
+    for (uint32_t p = 0; p < 4 && ok; p++) {
+        ok = fwrite(parts[p]->limbs, sizeof(uint32_t), header.num_limbs, f) == header.num_limbs;
+    }
+    ok = ok && fwrite(ref->orbit, 2 * sizeof(double), ref->length, f) == ref->length;
+    ok = (fclose(f) == 0) && ok;
+
+    if (!ok) {
+        fprintf(stderr, "Couldn't write %s\n", entry->path);
+        remove(entry->path);
+        return false;
+    }
+    entry->spill_current = true;
+    cache->stats.spills++;
+    return true;
+}
+
+// header and c_re, c_im; f is left at z_re
+static bool read_spill_key(FILE* f, spill_header_t* header, bignum_t** out_c_re, bignum_t** out_c_im) {
+    if (fread(header, sizeof(*header), 1, f) != 1 || memcmp(header->magic, SPILL_MAGIC, sizeof(header->magic)) != 0) {
+        return false;
+    }
+    if (header->num_limbs == 0 || header->num_limbs != bignum_limbs_for_bits(header->precision_bits)) {
+        return false;
+    }
+
+    bignum_t* c_re = bignum_create(header->num_limbs);
+    bignum_t* c_im = bignum_create(header->num_limbs);
+    if (fread(c_re->limbs, sizeof(uint32_t), header->num_limbs, f) != header->num_limbs
+        || fread(c_im->limbs, sizeof(uint32_t), header->num_limbs, f) != header->num_limbs) {
+        bignum_destroy(c_im);
+        bignum_destroy(c_re);
+        return false;
+    }
+    c_re->negative = header->negative & 1;
+    c_im->negative = (header->negative >> 1) & 1;
+    *out_c_re = c_re;
+    *out_c_im = c_im;
+    return true;
+}
+
+static reference_orbit_t* read_spill(const char* path) {
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        return NULL;
+    }
+
+    spill_header_t header;
+    bignum_t* c_re;
+    bignum_t* c_im;
+    if (!read_spill_key(f, &header, &c_re, &c_im)) {
+        fclose(f);
+        return NULL;
+    }
+
+    reference_orbit_t* ref = malloc(sizeof(*ref));
+    ref->c_re = c_re;
+    ref->c_im = c_im;
+    ref->c_re_d = bignum_to_double(c_re);
+    ref->c_im_d = bignum_to_double(c_im);
+    ref->precision_bits = header.precision_bits;
+    ref->max_iter = header.max_iter;
+    ref->length = header.length;
+    ref->escaped = header.escaped != 0;
+    ref->z_re = bignum_create(header.num_limbs);
+    ref->z_im = bignum_create(header.num_limbs);
+    ref->z_re->negative = (header.negative >> 2) & 1;
+    ref->z_im->negative = (header.negative >> 3) & 1;
+    ref->orbit = malloc(((size_t) header.length + 1) * 2 * sizeof(double));
+
+    bool ok = fread(ref->z_re->limbs, sizeof(uint32_t), header.num_limbs, f) == header.num_limbs
+        && fread(ref->z_im->limbs, sizeof(uint32_t), header.num_limbs, f) == header.num_limbs
+        && fread(ref->orbit, 2 * sizeof(double), header.length, f) == header.length;
+    fclose(f);
+
+    if (!ok) {
+        reference_orbit_destroy(ref);
+        return NULL;
+    }
+    return ref;
+}
+
+// the files an earlier cache on the same dir left behind
+static void scan_spill_dir(reference_cache_t* cache) {
+    mkdir(cache->spill_dir, 0755);
+    DIR* dir = opendir(cache->spill_dir);
+    if (!dir) {
+        fprintf(stderr, "Couldn't open %s, orbits won't be spilled\n", cache->spill_dir);
+        free(cache->spill_dir);
+        cache->spill_dir = NULL;
+        return;
+    }
+
+    struct dirent* de;
+    while ((de = readdir(dir))) {
+        size_t len = strlen(de->d_name);
+        size_t suffix_len = strlen(SPILL_SUFFIX);
+        if (len <= suffix_len || strcmp(de->d_name + len - suffix_len, SPILL_SUFFIX) != 0) {
+            continue;
+        }
+
+        char* path = join_path(cache->spill_dir, de->d_name);
+        FILE* f = fopen(path, "rb");
+        spill_header_t header;
+        bignum_t* c_re;
+        bignum_t* c_im;
+        if (!f || !read_spill_key(f, &header, &c_re, &c_im)) {
+            if (f) {
+                fclose(f);
+            }
+            free(path);
+            continue;
+        }
+        fclose(f);
+
+        cache_entry_t* entry = append_entry(cache);
+        entry->c_re = c_re;
+        entry->c_im = c_im;
+        entry->precision_bits = header.precision_bits;
+        entry->length = header.length;
+        entry->escaped = header.escaped != 0;
+        entry->path = path;
+        entry->spill_current = true;
+    }
+    closedir(dir);
+}
+
+reference_cache_t* reference_cache_create(size_t max_bytes, const char* spill_dir) {
+    reference_cache_t* cache = calloc(1, sizeof(*cache));
+    cache->max_bytes = max_bytes;
+    if (spill_dir) {
+        cache->spill_dir = strdup(spill_dir);
+        scan_spill_dir(cache);
+    }
+    return cache;
+}
+
+void reference_cache_destroy(reference_cache_t* cache) {
+    while (cache->num_entries > 0) {
+        cache_entry_t* entry = &cache->entries[cache->num_entries - 1];
+        if (entry->ref && cache->spill_dir && !entry->spill_current) {
+            write_spill(cache, entry);
+        }
+        remove_entry(cache, cache->num_entries - 1, true);
+    }
+    free(cache->entries);
+    free(cache->spill_dir);
+    free(cache);
+}
+
+// |C - (c_re, c_im)| on both axes, at the entry's precision
+static bool within(const cache_entry_t* entry, const bignum_t* c_re, const bignum_t* c_im, double max_distance) {
+    bignum_t* d = bignum_create(entry->c_re->num_limbs);
+    bignum_copy(d, c_re);
+    bignum_sub(d, d, entry->c_re);
+    double d_re = fabs(bignum_to_double(d));
+    bignum_copy(d, c_im);
+    bignum_sub(d, d, entry->c_im);
+    double d_im = fabs(bignum_to_double(d));
+    bignum_destroy(d);
+    return d_re <= max_distance && d_im <= max_distance;
+}
+
+reference_orbit_t* reference_cache_take(reference_cache_t* cache, const bignum_t* c_re, const bignum_t* c_im, double max_distance, uint32_t precision_bits, bla_table_t** out_bla) {
+    *out_bla = NULL;
+
+    // longest first: an escaped orbit is as long as any view needs
+    int64_t best = -1;
+    for (uint32_t i = 0; i < cache->num_entries; i++) {
+        const cache_entry_t* entry = &cache->entries[i];
+        if (entry->precision_bits < precision_bits || !within(entry, c_re, c_im, max_distance)) {
+            continue;
+        }
+        if (best < 0) {
+            best = i;
+            continue;
+        }
+        const cache_entry_t* b = &cache->entries[best];
+        if ((entry->escaped && !b->escaped) || (entry->escaped == b->escaped && entry->length > b->length)) {
+            best = i;
+        }
+    }
+
+    if (best >= 0) {
+        cache_entry_t* entry = &cache->entries[best];
+        reference_orbit_t* ref = entry->ref;
+        bool from_disk = !ref;
+        if (from_disk) {
+            ref = read_spill(entry->path);
+        }
+        if (!ref) {
+            // the file went away or got cut short; forget it
+            fprintf(stderr, "Couldn't read %s\n", entry->path);
+            remove_entry(cache, (uint32_t) best, true);
+            cache->stats.misses++;
+            return NULL;
+        }
+
+        if (entry->bla && entry->bla->ref == ref) {
+            *out_bla = entry->bla;
+            entry->bla = NULL;
+        }
+        // out until reference_cache_put() hands it back, which stamps it as
+        // the most recently used
+        entry->ref = NULL;
+        remove_entry(cache, (uint32_t) best, true);
+
+        cache->stats.hits++;
+        cache->stats.disk_hits += from_disk;
+        return ref;
+    }
+
+    cache->stats.misses++;
+    return NULL;
+}
+
+void reference_cache_put(reference_cache_t* cache, reference_orbit_t* ref, bla_table_t* bla) {
+    cache_entry_t* entry = append_entry(cache);
+    entry->c_re = bignum_create(ref->c_re->num_limbs);
+    entry->c_im = bignum_create(ref->c_im->num_limbs);
+    bignum_copy(entry->c_re, ref->c_re);
+    bignum_copy(entry->c_im, ref->c_im);
+    entry->precision_bits = ref->precision_bits;
+    entry->length = ref->length;
+    entry->escaped = ref->escaped;
+    entry->ref = ref;
+    entry->bla = (bla && bla->ref == ref) ? bla : NULL;
+    // a hit takes its entry out of the cache, and the orbit comes back
+    // through here once the caller is done with it, so this stamp is the
+    // orbit's last use and not just when it was first computed
+    entry->last_used = ++cache->clock;
+    if (bla && !entry->bla) {
+        bla_table_destroy(bla);
+    }
+
+    // least recently used out, until the rest fits
+    size_t bytes = total_bytes(cache);
+    while (bytes > cache->max_bytes) {
+        int64_t lru = -1;
+        for (uint32_t i = 0; i < cache->num_entries; i++) {
+            if (cache->entries[i].ref && (lru < 0 || cache->entries[i].last_used < cache->entries[lru].last_used)) {
+                lru = i;
+            }
+        }
+        if (lru < 0) {
+            break;
+        }
+
+        cache_entry_t* victim = &cache->entries[lru];
+        bytes -= entry_bytes(victim);
+        if (cache->spill_dir && (victim->spill_current || write_spill(cache, victim))) {
+            free_loaded(victim);
+        } else {
+            remove_entry(cache, (uint32_t) lru, true);
+        }
+    }
+}
+
+reference_cache_stats_t reference_cache_stats(const reference_cache_t* cache) {
+    reference_cache_stats_t stats = cache->stats;
+    stats.bytes = total_bytes(cache);
+    return stats;
+}
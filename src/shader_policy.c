@@ -0,0 +1,79 @@
+#include <stdbool.h>
+#include <inttypes.h>
+#include <float.h>
+
+#include <kernels.h>
+#include <mandelbrot.h>
+#include <shader_policy.h>
+
+// weight of the newest measurement in the moving average; frame times are
+// noisy, and the view (so the share of interior pixels) keeps changing
+#define COST_SMOOTHING .25
+
+static const double variant_epsilon[SHADER_VARIANT_COUNT] = {
+    [SHADER_VARIANT_FLOAT] = FLT_EPSILON,
+    [SHADER_VARIANT_DOUBLE_FLOAT] = DOUBLE_FLOAT_EPSILON,
+    [SHADER_VARIANT_FP64] = DBL_EPSILON,
+};
+
+const char* shader_variant_name(shader_variant_t variant) {
+    switch (variant) {
+        case SHADER_VARIANT_FLOAT: return "float";
+        case SHADER_VARIANT_DOUBLE_FLOAT: return "double-float";
+        case SHADER_VARIANT_FP64: return "fp64";
+        default: return "?";
+    }
+}
+
+void shader_policy_init(shader_policy_t* policy, const bool* available) {
+    for (uint32_t v = 0; v < SHADER_VARIANT_COUNT; v++) {
+        policy->available[v] = available[v];
+        policy->cost[v] = 0.;
+    }
+}
+
+shader_variant_t shader_policy_choose(const shader_policy_t* policy, const view_t* view, bool* out_precise) {
+    // nothing beats plain float, no need to measure that
+    if (policy->available[SHADER_VARIANT_FLOAT] && kernel_float_precision_ok(view)) {
+        *out_precise = true;
+        return SHADER_VARIANT_FLOAT;
+    }
+
+    shader_variant_t best = SHADER_VARIANT_COUNT;
+    for (uint32_t v = SHADER_VARIANT_DOUBLE_FLOAT; v < SHADER_VARIANT_COUNT; v++) {
+        if (!policy->available[v] || !kernel_precision_ok(view, variant_epsilon[v])) {
+            continue;
+        }
+        if (policy->cost[v] == 0.) {
+            best = v;
+            break;
+        }
+        if (best == SHADER_VARIANT_COUNT || policy->cost[v] < policy->cost[best]) {
+            best = v;
+        }
+    }
+
+    if (best != SHADER_VARIANT_COUNT) {
+        *out_precise = true;
+        return best;
+    }
+
+    *out_precise = false;
+    for (uint32_t v = SHADER_VARIANT_COUNT; v-- > 0;) {
+        if (policy->available[v]) {
+            return v;
+        }
+    }
+    return SHADER_VARIANT_FLOAT;
+}
+
+void shader_policy_record(shader_policy_t* policy, shader_variant_t variant, double seconds, double pixels, uint32_t max_iter) {
+    double work = pixels * max_iter;
+    if (work <= 0.) {
+        return;
+    }
+
+    double cost = seconds / work;
+    double* avg = &policy->cost[variant];
+    *avg = (*avg == 0.) ? cost : *avg + COST_SMOOTHING * (cost - *avg);
+}
@@ -0,0 +1,137 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include <thread_pool.h>
+#include <trace.h>
+
+struct thread_pool {
+    uint32_t num_workers;
+    pthread_t* threads;
+
+    pthread_mutex_t lock;
+    pthread_cond_t job_ready;
+    pthread_cond_t job_done;
+
+    // bumped once per thread_pool_run(), workers wait for it to change
+    uint64_t generation;
+    uint32_t num_running;
+    bool shutting_down;
+
+    thread_pool_fn fn;
+    void* ctx;
+};
+
+typedef struct {
+    thread_pool_t* pool;
+    uint32_t worker;
+} worker_arg_t;
+
+static void* worker_main(void* arg) {
+    worker_arg_t* wa = arg;
+    thread_pool_t* pool = wa->pool;
+    uint32_t worker = wa->worker;
+    free(wa);
+
+    char name[32];
+    snprintf(name, sizeof(name), "worker %" PRIu32, worker);
+    trace_thread_name(name);
+
+    uint64_t seen_generation = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    while (true) {
+        while (pool->generation == seen_generation && !pool->shutting_down) {
+            pthread_cond_wait(&pool->job_ready, &pool->lock);
+        }
+        if (pool->shutting_down) { break; }
+        seen_generation = pool->generation;
+
+        thread_pool_fn fn = pool->fn;
+        void* ctx = pool->ctx;
+        pthread_mutex_unlock(&pool->lock);
+
+        trace_begin("job");
+        fn(ctx, worker, pool->num_workers);
+        trace_end();
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->num_running == 0) {
+            pthread_cond_signal(&pool->job_done);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    return NULL;
+}
+
+thread_pool_t* thread_pool_create(uint32_t num_threads) {
+    if (num_threads == 0) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        num_threads = (online > 0) ? (uint32_t) online : 1;
+    }
+
+    thread_pool_t* pool = calloc(1, sizeof(*pool));
+    pool->num_workers = num_threads;
+    pool->threads = calloc(num_threads, sizeof(pthread_t));
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->job_ready, NULL);
+    pthread_cond_init(&pool->job_done, NULL);
+
+    // worker 0 is whoever calls thread_pool_run()
+    for (uint32_t i = 1; i < num_threads; i++) {
+        worker_arg_t* wa = malloc(sizeof(*wa));
+        wa->pool = pool;
+        wa->worker = i;
+        if (pthread_create(&pool->threads[i], NULL, worker_main, wa) != 0) {
+            fprintf(stderr, "Couldn't create worker thread %" PRIu32 "!\n", i);
+            exit(-1);
+        }
+    }
+
+    return pool;
+}
+
+void thread_pool_destroy(thread_pool_t* pool) {
+    pthread_mutex_lock(&pool->lock);
+    pool->shutting_down = true;
+    pthread_cond_broadcast(&pool->job_ready);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (uint32_t i = 1; i < pool->num_workers; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+
+    pthread_cond_destroy(&pool->job_done);
+    pthread_cond_destroy(&pool->job_ready);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->threads);
+    free(pool);
+}
+
+uint32_t thread_pool_size(const thread_pool_t* pool) {
+    return pool->num_workers;
+}
+
+void thread_pool_run(thread_pool_t* pool, thread_pool_fn fn, void* ctx) {
+    pthread_mutex_lock(&pool->lock);
+    pool->fn = fn;
+    pool->ctx = ctx;
+    pool->num_running = pool->num_workers - 1;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->job_ready);
+    pthread_mutex_unlock(&pool->lock);
+
+    trace_begin("job");
+    fn(ctx, 0, pool->num_workers);
+    trace_end();
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->num_running > 0) {
+        pthread_cond_wait(&pool->job_done, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
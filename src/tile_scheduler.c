@@ -0,0 +1,250 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <inttypes.h>
+#include <sched.h>
+
+#include <tile_scheduler.h>
+#include <util.h>
+
+#define CACHE_LINE 64
+#define MIN_DEQUE_CAPACITY 64
+
+// Chase-Lev deque with the C11 orderings from Le et al., "Correct and
+// Efficient Work-Stealing for Weak Memory Models" (PPoPP '13). the buffer
+// never grows while workers are running; tile_scheduler_reset() sizes it
+typedef struct {
+    alignas(CACHE_LINE) atomic_int_fast64_t top;
+    alignas(CACHE_LINE) atomic_int_fast64_t bottom;
+    alignas(CACHE_LINE) _Atomic uint32_t* buffer;
+    uint64_t mask;
+} deque_t;
+
+typedef struct {
+    alignas(CACHE_LINE) tile_worker_stats_t stats;
+    uint64_t rng;
+} worker_state_t;
+
+struct tile_scheduler {
+    uint32_t num_workers;
+    uint64_t capacity;
+    deque_t* deques;
+    worker_state_t* workers;
+
+    // tiles queued but not finished; workers stop once it hits zero
+    alignas(CACHE_LINE) atomic_uint_fast64_t remaining;
+};
+
+#define DEQUE_EMPTY UINT32_MAX
+#define DEQUE_ABORT (UINT32_MAX - 1)
+
+// owner only
+static bool deque_push(deque_t* dq, uint32_t tile) {
+    int64_t b = atomic_load_explicit(&dq->bottom, memory_order_relaxed);
+    int64_t t = atomic_load_explicit(&dq->top, memory_order_acquire);
+    if ((uint64_t) (b - t) > dq->mask) {
+        return false;
+    }
+
+    atomic_store_explicit(&dq->buffer[b & dq->mask], tile, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&dq->bottom, b + 1, memory_order_relaxed);
+    return true;
+}
+
+// owner only
+static uint32_t deque_take(deque_t* dq) {
+    int64_t b = atomic_load_explicit(&dq->bottom, memory_order_relaxed) - 1;
+    atomic_store_explicit(&dq->bottom, b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    int64_t t = atomic_load_explicit(&dq->top, memory_order_relaxed);
+
+    if (t > b) {
+        atomic_store_explicit(&dq->bottom, b + 1, memory_order_relaxed);
+        return DEQUE_EMPTY;
+    }
+
+    uint32_t tile = atomic_load_explicit(&dq->buffer[b & dq->mask], memory_order_relaxed);
+    if (t == b) {
+        // last one left, race the thieves for it
+        if (!atomic_compare_exchange_strong_explicit(&dq->top, &t, t + 1, memory_order_seq_cst, memory_order_relaxed)) {
+            tile = DEQUE_EMPTY;
+        }
+        atomic_store_explicit(&dq->bottom, b + 1, memory_order_relaxed);
+    }
+    return tile;
+}
+
+// any thread
+static uint32_t deque_steal(deque_t* dq) {
+    int64_t t = atomic_load_explicit(&dq->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    int64_t b = atomic_load_explicit(&dq->bottom, memory_order_acquire);
+
+    if (t >= b) {
+        return DEQUE_EMPTY;
+    }
+
+    uint32_t tile = atomic_load_explicit(&dq->buffer[t & dq->mask], memory_order_relaxed);
+    if (!atomic_compare_exchange_strong_explicit(&dq->top, &t, t + 1, memory_order_seq_cst, memory_order_relaxed)) {
+        return DEQUE_ABORT;
+    }
+    return tile;
+}
+
+static uint64_t xorshift64(uint64_t* state) {
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return *state = x;
+}
+
+static void alloc_deques(tile_scheduler_t* sched, uint64_t capacity) {
+    sched->capacity = capacity;
+    for (uint32_t w = 0; w < sched->num_workers; w++) {
+        free(sched->deques[w].buffer);
+        sched->deques[w].buffer = calloc(capacity, sizeof(uint32_t));
+        sched->deques[w].mask = capacity - 1;
+    }
+}
+
+tile_scheduler_t* tile_scheduler_create(uint32_t num_workers) {
+    tile_scheduler_t* sched = aligned_alloc(CACHE_LINE, sizeof(*sched));
+    sched->num_workers = num_workers;
+    sched->deques = aligned_alloc(CACHE_LINE, num_workers * sizeof(deque_t));
+    sched->workers = aligned_alloc(CACHE_LINE, num_workers * sizeof(worker_state_t));
+
+    for (uint32_t w = 0; w < num_workers; w++) {
+        atomic_init(&sched->deques[w].top, 0);
+        atomic_init(&sched->deques[w].bottom, 0);
+        sched->deques[w].buffer = NULL;
+        sched->workers[w].rng = 0x9E3779B97F4A7C15ull * (w + 1);
+        sched->workers[w].stats = (tile_worker_stats_t) { 0 };
+    }
+    atomic_init(&sched->remaining, 0);
+
+    alloc_deques(sched, MIN_DEQUE_CAPACITY);
+    return sched;
+}
+
+void tile_scheduler_destroy(tile_scheduler_t* sched) {
+    for (uint32_t w = 0; w < sched->num_workers; w++) {
+        free(sched->deques[w].buffer);
+    }
+    free(sched->workers);
+    free(sched->deques);
+    free(sched);
+}
+
+void tile_scheduler_reset(tile_scheduler_t* sched, uint32_t num_tiles) {
+    // room for every tile in one deque, so pushes from split tiles rarely
+    // overflow into running inline
+    uint64_t capacity = sched->capacity;
+    while (capacity < (uint64_t) num_tiles * 2) {
+        capacity *= 2;
+    }
+    if (capacity != sched->capacity) {
+        alloc_deques(sched, capacity);
+    }
+
+    uint32_t per_worker = num_tiles / sched->num_workers;
+    uint32_t extra = num_tiles % sched->num_workers;
+    uint32_t first = 0;
+
+    for (uint32_t w = 0; w < sched->num_workers; w++) {
+        deque_t* dq = &sched->deques[w];
+        uint32_t count = per_worker + (w < extra ? 1 : 0);
+
+        // pushed back to front, so the owner pops its run in scanline
+        // order and thieves take from the far end of it
+        atomic_store_explicit(&dq->top, 0, memory_order_relaxed);
+        for (uint32_t i = 0; i < count; i++) {
+            atomic_store_explicit(&dq->buffer[i], first + count - 1 - i, memory_order_relaxed);
+        }
+        atomic_store_explicit(&dq->bottom, count, memory_order_relaxed);
+
+        sched->workers[w].stats = (tile_worker_stats_t) { 0 };
+        first += count;
+    }
+
+    atomic_store_explicit(&sched->remaining, num_tiles, memory_order_release);
+}
+
+static void run_tile(tile_scheduler_t* sched, uint32_t worker, uint32_t tile, tile_fn fn, void* ctx) {
+    tile_worker_stats_t* stats = &sched->workers[worker].stats;
+
+    double start_time = now_seconds();
+    fn(ctx, worker, tile);
+    stats->busy_time += now_seconds() - start_time;
+    stats->tiles++;
+
+    atomic_fetch_sub_explicit(&sched->remaining, 1, memory_order_acq_rel);
+}
+
+void tile_scheduler_work(tile_scheduler_t* sched, uint32_t worker, tile_fn fn, void* ctx) {
+    deque_t* own = &sched->deques[worker];
+    worker_state_t* ws = &sched->workers[worker];
+
+    while (atomic_load_explicit(&sched->remaining, memory_order_acquire) > 0) {
+        uint32_t tile = deque_take(own);
+        if (tile != DEQUE_EMPTY) {
+            run_tile(sched, worker, tile, fn, ctx);
+            continue;
+        }
+
+        if (sched->num_workers == 1) {
+            continue;
+        }
+
+        // out of local work: try victims starting at a random one
+        bool stole = false;
+        uint32_t start = (uint32_t) (xorshift64(&ws->rng) % sched->num_workers);
+        for (uint32_t i = 0; i < sched->num_workers && !stole; i++) {
+            uint32_t victim = (start + i) % sched->num_workers;
+            if (victim == worker) { continue; }
+
+            tile = deque_steal(&sched->deques[victim]);
+            if (tile < DEQUE_ABORT) {
+                ws->stats.steals++;
+                run_tile(sched, worker, tile, fn, ctx);
+                stole = true;
+            } else {
+                ws->stats.failed_steals++;
+            }
+        }
+
+        // everything left is already running somewhere else
+        if (!stole) {
+            sched_yield();
+        }
+    }
+}
+
+void tile_scheduler_push(tile_scheduler_t* sched, uint32_t worker, uint32_t tile, tile_fn fn, void* ctx) {
+    atomic_fetch_add_explicit(&sched->remaining, 1, memory_order_acq_rel);
+    if (!deque_push(&sched->deques[worker], tile)) {
+        run_tile(sched, worker, tile, fn, ctx);
+    }
+}
+
+uint32_t tile_scheduler_num_workers(const tile_scheduler_t* sched) {
+    return sched->num_workers;
+}
+
+const tile_worker_stats_t* tile_scheduler_worker_stats(const tile_scheduler_t* sched, uint32_t worker) {
+    return &sched->workers[worker].stats;
+}
+
+tile_worker_stats_t tile_scheduler_total_stats(const tile_scheduler_t* sched) {
+    tile_worker_stats_t total = { 0 };
+    for (uint32_t w = 0; w < sched->num_workers; w++) {
+        const tile_worker_stats_t* stats = &sched->workers[w].stats;
+        total.tiles += stats->tiles;
+        total.steals += stats->steals;
+        total.failed_steals += stats->failed_steals;
+        total.busy_time += stats->busy_time;
+    }
+    return total;
+}
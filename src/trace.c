@@ -0,0 +1,159 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
+
+#include <trace.h>
+
+// deeper scopes than this are neither recorded nor complain
+#define MAX_DEPTH 32
+
+typedef struct {
+    const char* name;
+    uint64_t start_ns;
+    uint64_t duration_ns;
+} trace_event_t;
+
+typedef struct trace_buffer {
+    struct trace_buffer* next;
+    uint32_t tid;
+    char thread_name[32];   // "" = just the tid
+    // events ever written; [count - TRACE_BUFFER_EVENTS, count) are still
+    // there. release, so the exit flush sees whole events
+    _Atomic uint64_t count;
+
+    // open scopes
+    uint32_t depth;
+    const char* open_name[MAX_DEPTH];
+    uint64_t open_start_ns[MAX_DEPTH];
+
+    trace_event_t events[TRACE_BUFFER_EVENTS];
+} trace_buffer_t;
+
+// set once by trace_start(), before any thread but main exists
+static bool enabled = false;
+static const char* trace_path;
+static uint64_t start_ns;
+
+static _Atomic(trace_buffer_t*) buffers = NULL;
+static _Atomic uint32_t next_tid = 1;
+static _Thread_local trace_buffer_t* local = NULL;
+
+static uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000u + (uint64_t) ts.tv_nsec;
+}
+
+// the calling thread's, made and pushed onto buffers the first time
+static trace_buffer_t* local_buffer() {
+    if (local) {
+        return local;
+    }
+    trace_buffer_t* buffer = calloc(1, sizeof(*buffer));
+    buffer->tid = atomic_fetch_add_explicit(&next_tid, 1, memory_order_relaxed);
+    atomic_init(&buffer->count, 0);
+
+    trace_buffer_t* head = atomic_load_explicit(&buffers, memory_order_relaxed);
+    do {
+        buffer->next = head;
+    } while (!atomic_compare_exchange_weak_explicit(&buffers, &head, buffer, memory_order_release, memory_order_relaxed));
+    local = buffer;
+    return buffer;
+}
+
+// event names are string literals, nothing in them needs escaping
+static void write_trace() {
+    FILE* f = fopen(trace_path, "w");
+    if (!f) {
+        fprintf(stderr, "Failed to write %s\n", trace_path);
+        return;
+    }
+    fprintf(f, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    bool first = true;
+    for (trace_buffer_t* buffer = atomic_load_explicit(&buffers, memory_order_acquire); buffer; buffer = buffer->next) {
+        if (buffer->thread_name[0]) {
+            fprintf(
+                f, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %" PRIu32 ", \"args\": {\"name\": \"%s\"}}",
+                first ? "" : ",\n", buffer->tid, buffer->thread_name
+            );
+            first = false;
+        }
+        uint64_t count = atomic_load_explicit(&buffer->count, memory_order_acquire);
+        uint64_t oldest = (count > TRACE_BUFFER_EVENTS) ? count - TRACE_BUFFER_EVENTS : 0;
+        for (uint64_t i = oldest; i < count; i++) {
+            const trace_event_t* event = &buffer->events[i % TRACE_BUFFER_EVENTS];
+            fprintf(
+                f, "%s{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %" PRIu32 ", \"ts\": %.3f, \"dur\": %.3f}",
+                first ? "" : ",\n", event->name, buffer->tid,
+                (double) (event->start_ns - start_ns) * 1e-3, (double) event->duration_ns * 1e-3
+            );
+            first = false;
+        }
+    }
+    fprintf(f, "\n]}\n");
+    if (fclose(f) != 0) {
+        fprintf(stderr, "Failed to write %s\n", trace_path);
+    }
+}
+
+bool trace_start(const char* path) {
+    // fail now rather than at exit
+    FILE* f = fopen(path, "w");
+    if (!f) {
+        return false;
+    }
+    fclose(f);
+
+    trace_path = path;
+    start_ns = now_ns();
+    enabled = true;
+    atexit(write_trace);
+    trace_thread_name("main");
+    return true;
+}
+
+void trace_thread_name(const char* name) {
+    if (!enabled) {
+        return;
+    }
+    trace_buffer_t* buffer = local_buffer();
+    snprintf(buffer->thread_name, sizeof(buffer->thread_name), "%s", name);
+}
+
+void trace_begin(const char* name) {
+    if (!enabled) {
+        return;
+    }
+    trace_buffer_t* buffer = local_buffer();
+    if (buffer->depth < MAX_DEPTH) {
+        buffer->open_name[buffer->depth] = name;
+        buffer->open_start_ns[buffer->depth] = now_ns();
+    }
+    buffer->depth++;
+}
+
+void trace_end() {
+    if (!enabled) {
+        return;
+    }
+    trace_buffer_t* buffer = local_buffer();
+    if (buffer->depth == 0) {
+        return;
+    }
+    buffer->depth--;
+    if (buffer->depth >= MAX_DEPTH) {
+        return;
+    }
+
+    // only this thread writes count, so a relaxed load is its own latest
+    uint64_t count = atomic_load_explicit(&buffer->count, memory_order_relaxed);
+    trace_event_t* event = &buffer->events[count % TRACE_BUFFER_EVENTS];
+    event->name = buffer->open_name[buffer->depth];
+    event->start_ns = buffer->open_start_ns[buffer->depth];
+    event->duration_ns = now_ns() - event->start_ns;
+    atomic_store_explicit(&buffer->count, count + 1, memory_order_release);
+}
@@ -0,0 +1,37 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
+
+#include <util.h>
+
+double now_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec * 1e-9;
+}
+
+int compare_double(const void* a, const void* b) {
+    double x = *(const double*) a;
+    double y = *(const double*) b;
+    return (x > y) - (x < y);
+}
+
+const char* flag_value(const char* arg, const char* name) {
+    size_t len = strlen(name);
+    if (strncmp(arg, name, len) != 0 || arg[len] != '=') {
+        return NULL;
+    }
+    return &arg[len + 1];
+}
+
+bool parse_u32(const char* s, uint32_t* out) {
+    char* end;
+    unsigned long v = strtoul(s, &end, 10);
+    if (*s == '\0' || *end != '\0' || v > UINT32_MAX) {
+        return false;
+    }
+    *out = (uint32_t) v;
+    return true;
+}
@@ -0,0 +1,70 @@
+#include <stdbool.h>
+#include <inttypes.h>
+#include <math.h>
+
+#include <cpu_render.h>
+#include <mandelbrot.h>
+#include <zoom_video.h>
+
+// bilinear at (px, py), which has to be at least a pixel inside fb
+static void sample(const framebuffer_t* fb, double px, double py, double* rgb) {
+    uint32_t x = (uint32_t) px;
+    uint32_t y = (uint32_t) py;
+    double fx = px - x;
+    double fy = py - y;
+    const uint8_t* p00 = &fb->pixels[((size_t) y * fb->width + x) * 3];
+    const uint8_t* p10 = p00 + 3;
+    const uint8_t* p01 = p00 + (size_t) fb->width * 3;
+    const uint8_t* p11 = p01 + 3;
+    for (uint32_t c = 0; c < 3; c++) {
+        double top = p00[c] + (p10[c] - p00[c]) * fx;
+        double bottom = p01[c] + (p11[c] - p01[c]) * fx;
+        rgb[c] += top + (bottom - top) * fy;
+    }
+}
+
+static bool inside(const framebuffer_t* fb, double px, double py) {
+    return px >= 0. && py >= 0. && px < (double) fb->width - 1. && py < (double) fb->height - 1.;
+}
+
+// one point of the frame: from the inner keyframe where it reaches, the
+// outer one elsewhere, clamped to it at the very edge
+static void sample_keyframes(const zoom_keyframe_t* outer, const zoom_keyframe_t* inner, double dx, double dy, double* rgb) {
+    double px, py;
+    if (inner) {
+        view_delta_to_pixel(&inner->view, dx, dy, &px, &py);
+        if (inside(inner->fb, px, py)) {
+            sample(inner->fb, px, py, rgb);
+            return;
+        }
+    }
+    view_delta_to_pixel(&outer->view, dx, dy, &px, &py);
+    px = fmin(fmax(px, 0.), (double) outer->fb->width - 1.000001);
+    py = fmin(fmax(py, 0.), (double) outer->fb->height - 1.000001);
+    sample(outer->fb, px, py, rgb);
+}
+
+void zoom_video_frame(const zoom_keyframe_t* outer, const zoom_keyframe_t* inner, const view_t* frame, framebuffer_t* out) {
+    // a frame pixel spans up to two outer keyframe pixels, so a single
+    // bilinear tap would alias; four, a quarter pixel out each way, come
+    // close to averaging over it
+    double quarter = .25 * view_pixel_size(frame);
+
+    for (uint32_t y = 0; y < frame->height; y++) {
+        for (uint32_t x = 0; x < frame->width; x++) {
+            double dx, dy;
+            view_pixel_to_delta(frame, x, y, &dx, &dy);
+
+            double rgb[3] = { 0., 0., 0. };
+            sample_keyframes(outer, inner, dx - quarter, dy - quarter, rgb);
+            sample_keyframes(outer, inner, dx + quarter, dy - quarter, rgb);
+            sample_keyframes(outer, inner, dx - quarter, dy + quarter, rgb);
+            sample_keyframes(outer, inner, dx + quarter, dy + quarter, rgb);
+
+            uint8_t* pixel = &out->pixels[((size_t) y * frame->width + x) * 3];
+            for (uint32_t c = 0; c < 3; c++) {
+                pixel[c] = (uint8_t) (rgb[c] * .25 + .5);
+            }
+        }
+    }
+}